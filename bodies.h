@@ -0,0 +1,441 @@
+#ifndef BODIES_H
+#define BODIES_H
+
+#include <vector>
+#include <cstring>
+
+#include <glm/glm.hpp>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define BODIES_AVX
+#endif
+
+//stable id of a body inside a bodyStorage, the index behind it changes when bodies are removed
+typedef int bodyHandle;
+const bodyHandle NO_BODY = -1;
+
+//flag bits stored per body
+const unsigned int BODY_GRAVITY = 1 << 0;
+const unsigned int BODY_ON_GROUND = 1 << 1;
+const unsigned int BODY_COLLISION = 1 << 2;
+const unsigned int BODY_STATIC = 1 << 3;
+const unsigned int BODY_SLEEPING = 1 << 4; // resting, not integrated until woken
+const unsigned int BODY_BULLET = 1 << 5; // fast mover, swept against the other bodies so it cannot tunnel
+
+//the state of one body, used to create bodies and to move them between storages
+struct bodyState{
+    glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f); //object center
+    glm::vec3 velocity = glm::vec3(0.0f, 0.0f, 0.0f);
+    glm::vec3 acceleration = glm::vec3(0.0f, 0.0f, 0.0f);
+    float mass = 1.0f;
+    unsigned int flags = 0;
+};
+
+/* simulation state of many bodies in structure of arrays layout. Live bodies are always packed at
+the front of the arrays so the integration runs over contiguous memory, 8 bodies at a time with AVX2 */
+class bodyStorage{
+    public:
+    std::vector<float> positionX, positionY, positionZ;
+    std::vector<float> velocityX, velocityY, velocityZ;
+    std::vector<float> accelerationX, accelerationY, accelerationZ;
+    std::vector<float> mass;
+    std::vector<unsigned int> flags;
+    std::vector<bodyHandle> owner; // handle of the body stored at each index
+    std::vector<float> sleepTimer; // how long the body has been slower than the sleep velocity
+    std::vector<float> timeScale; // multiplies the step time of each body, 0 pauses it (physics LOD)
+
+    //positions before the last fixed step and how far the render time is past it, for interpolation
+    std::vector<float> previousX, previousY, previousZ;
+    float interpolation = 1.0f;
+
+    private:
+    std::vector<int> handleIndex; // handle -> index, -1 for free handles
+    std::vector<bodyHandle> freeHandles;
+
+    void write(int i, const bodyState &state)
+    {
+        positionX[i] = state.position.x;
+        positionY[i] = state.position.y;
+        positionZ[i] = state.position.z;
+        velocityX[i] = state.velocity.x;
+        velocityY[i] = state.velocity.y;
+        velocityZ[i] = state.velocity.z;
+        accelerationX[i] = state.acceleration.x;
+        accelerationY[i] = state.acceleration.y;
+        accelerationZ[i] = state.acceleration.z;
+        mass[i] = state.mass;
+        flags[i] = state.flags;
+        sleepTimer[i] = 0.0f;
+        timeScale[i] = 1.0f;
+        previousX[i] = state.position.x;
+        previousY[i] = state.position.y;
+        previousZ[i] = state.position.z;
+    }
+
+    void resize(int size)
+    {
+        positionX.resize(size);
+        positionY.resize(size);
+        positionZ.resize(size);
+        velocityX.resize(size);
+        velocityY.resize(size);
+        velocityZ.resize(size);
+        accelerationX.resize(size);
+        accelerationY.resize(size);
+        accelerationZ.resize(size);
+        mass.resize(size);
+        flags.resize(size);
+        owner.resize(size);
+        sleepTimer.resize(size);
+        timeScale.resize(size);
+        previousX.resize(size);
+        previousY.resize(size);
+        previousZ.resize(size);
+    }
+
+    //copies everything stored for body from to index to, the sleep, time scale and interpolation state included
+    void copyBody(int from, int to)
+    {
+        positionX[to] = positionX[from];
+        positionY[to] = positionY[from];
+        positionZ[to] = positionZ[from];
+        velocityX[to] = velocityX[from];
+        velocityY[to] = velocityY[from];
+        velocityZ[to] = velocityZ[from];
+        accelerationX[to] = accelerationX[from];
+        accelerationY[to] = accelerationY[from];
+        accelerationZ[to] = accelerationZ[from];
+        mass[to] = mass[from];
+        flags[to] = flags[from];
+        owner[to] = owner[from];
+        sleepTimer[to] = sleepTimer[from];
+        timeScale[to] = timeScale[from];
+        previousX[to] = previousX[from];
+        previousY[to] = previousY[from];
+        previousZ[to] = previousZ[from];
+    }
+
+    public:
+    bodyHandle create(const bodyState &state = bodyState())
+    {
+        bodyHandle handle;
+        if(!freeHandles.empty())
+        {
+            handle = freeHandles.back();
+            freeHandles.pop_back();
+        }
+        else
+        {
+            handle = handleIndex.size();
+            handleIndex.push_back(-1);
+        }
+
+        int index = owner.size();
+        resize(index + 1);
+        write(index, state);
+        owner[index] = handle;
+        handleIndex[handle] = index;
+        return handle;
+    }
+
+    //the last body moves into the hole so the arrays stay packed
+    void destroy(bodyHandle handle)
+    {
+        int index = handleIndex[handle];
+        int last = owner.size() - 1;
+
+        if(index != last)
+        {
+            copyBody(last, index);
+            handleIndex[owner[index]] = index;
+        }
+
+        resize(last);
+        handleIndex[handle] = -1;
+        freeHandles.push_back(handle);
+    }
+
+    int indexOf(bodyHandle handle) const
+    {
+        return handleIndex[handle];
+    }
+
+    int size() const
+    {
+        return owner.size();
+    }
+
+    bodyState getState(bodyHandle handle) const
+    {
+        int i = handleIndex[handle];
+
+        bodyState state;
+        state.position = glm::vec3(positionX[i], positionY[i], positionZ[i]);
+        state.velocity = glm::vec3(velocityX[i], velocityY[i], velocityZ[i]);
+        state.acceleration = glm::vec3(accelerationX[i], accelerationY[i], accelerationZ[i]);
+        state.mass = mass[i];
+        state.flags = flags[i];
+        return state;
+    }
+
+    void setState(bodyHandle handle, const bodyState &state)
+    {
+        write(handleIndex[handle], state);
+    }
+
+    glm::vec3 getPosition(bodyHandle handle) const
+    {
+        int i = handleIndex[handle];
+        return glm::vec3(positionX[i], positionY[i], positionZ[i]);
+    }
+
+    void setPosition(bodyHandle handle, glm::vec3 position)
+    {
+        int i = handleIndex[handle];
+        positionX[i] = position.x;
+        positionY[i] = position.y;
+        positionZ[i] = position.z;
+    }
+
+    //position between the last two fixed steps, at the current interpolation factor
+    glm::vec3 getRenderPosition(bodyHandle handle) const
+    {
+        int i = handleIndex[handle];
+        glm::vec3 previous(previousX[i], previousY[i], previousZ[i]);
+        return glm::mix(previous, glm::vec3(positionX[i], positionY[i], positionZ[i]), interpolation);
+    }
+
+    //called at the start of every fixed step, the current positions become the ones to interpolate from
+    void storePrevious()
+    {
+        previousX = positionX;
+        previousY = positionY;
+        previousZ = positionZ;
+    }
+
+    //0 renders the previous step, 1 the latest one
+    void setInterpolation(float alpha)
+    {
+        interpolation = alpha;
+    }
+
+    glm::vec3 getVelocity(bodyHandle handle) const
+    {
+        int i = handleIndex[handle];
+        return glm::vec3(velocityX[i], velocityY[i], velocityZ[i]);
+    }
+
+    void setVelocity(bodyHandle handle, glm::vec3 velocity)
+    {
+        int i = handleIndex[handle];
+        velocityX[i] = velocity.x;
+        velocityY[i] = velocity.y;
+        velocityZ[i] = velocity.z;
+    }
+
+    glm::vec3 getAcceleration(bodyHandle handle) const
+    {
+        int i = handleIndex[handle];
+        return glm::vec3(accelerationX[i], accelerationY[i], accelerationZ[i]);
+    }
+
+    void setAcceleration(bodyHandle handle, glm::vec3 acceleration)
+    {
+        int i = handleIndex[handle];
+        accelerationX[i] = acceleration.x;
+        accelerationY[i] = acceleration.y;
+        accelerationZ[i] = acceleration.z;
+    }
+
+    float getMass(bodyHandle handle) const
+    {
+        return mass[handleIndex[handle]];
+    }
+
+    void setMass(bodyHandle handle, float value)
+    {
+        mass[handleIndex[handle]] = value;
+    }
+
+    bool getFlag(bodyHandle handle, unsigned int flag) const
+    {
+        return (flags[handleIndex[handle]] & flag) != 0;
+    }
+
+    void setFlag(bodyHandle handle, unsigned int flag, bool status)
+    {
+        unsigned int &value = flags[handleIndex[handle]];
+        value = status ? (value | flag) : (value & ~flag);
+    }
+
+    void wake(bodyHandle handle)
+    {
+        int i = handleIndex[handle];
+        flags[i] &= ~BODY_SLEEPING;
+        sleepTimer[i] = 0.0f;
+    }
+
+    //stops the body, it keeps its place until it is woken
+    void sleep(bodyHandle handle)
+    {
+        int i = handleIndex[handle];
+        flags[i] |= BODY_SLEEPING;
+        velocityX[i] = velocityY[i] = velocityZ[i] = 0.0f;
+    }
+
+    //semi implicit euler, gravity only while in the air and no vertical speed while on the ground.
+    //sleeping bodies have no velocity and get no gravity, so they stay where they are
+    void integrateBody(int i, float deltaTime)
+    {
+        deltaTime *= timeScale[i];
+        bool falling = (flags[i] & BODY_GRAVITY) && !(flags[i] & (BODY_ON_GROUND | BODY_SLEEPING));
+
+        if(falling)
+        {
+            velocityX[i] += accelerationX[i] * deltaTime;
+            velocityY[i] += accelerationY[i] * deltaTime;
+            velocityZ[i] += accelerationZ[i] * deltaTime;
+        }
+
+        if(flags[i] & BODY_ON_GROUND)
+            velocityY[i] = 0.0f;
+
+        positionX[i] += velocityX[i] * deltaTime;
+        positionY[i] += velocityY[i] * deltaTime;
+        positionZ[i] += velocityZ[i] * deltaTime;
+    }
+
+    /* first half of integrateBody() for the indices [first, last), a contact solver runs between
+    the two halves so the positions move with the solved velocities */
+    void integrateVelocities(float deltaTime, int first = 0, int last = -1)
+    {
+        if(last < 0)
+            last = size();
+
+        int i = first;
+
+#ifdef BODIES_AVX
+        __m256 stepTime = _mm256_set1_ps(deltaTime);
+        __m256 zero = _mm256_setzero_ps();
+        __m256i gravityBit = _mm256_set1_epi32(BODY_GRAVITY);
+        __m256i groundBit = _mm256_set1_epi32(BODY_ON_GROUND);
+        __m256i restingBits = _mm256_set1_epi32(BODY_ON_GROUND | BODY_SLEEPING);
+        __m256i zeroInt = _mm256_setzero_si256();
+
+        for(; i + 8 <= last; i += 8)
+        {
+            __m256 dt = _mm256_mul_ps(stepTime, _mm256_loadu_ps(&timeScale[i]));
+            __m256i bodyFlags = _mm256_loadu_si256((const __m256i*)&flags[i]);
+            __m256i hasGravity = _mm256_xor_si256(_mm256_cmpeq_epi32(_mm256_and_si256(bodyFlags, gravityBit), zeroInt), _mm256_set1_epi32(-1));
+            __m256i onGround = _mm256_xor_si256(_mm256_cmpeq_epi32(_mm256_and_si256(bodyFlags, groundBit), zeroInt), _mm256_set1_epi32(-1));
+            __m256i resting = _mm256_xor_si256(_mm256_cmpeq_epi32(_mm256_and_si256(bodyFlags, restingBits), zeroInt), _mm256_set1_epi32(-1));
+            __m256 falling = _mm256_castsi256_ps(_mm256_andnot_si256(resting, hasGravity));
+            __m256 grounded = _mm256_castsi256_ps(onGround);
+
+            //velocity change is masked to the falling lanes
+            __m256 vx = _mm256_add_ps(_mm256_loadu_ps(&velocityX[i]), _mm256_and_ps(falling, _mm256_mul_ps(_mm256_loadu_ps(&accelerationX[i]), dt)));
+            __m256 vy = _mm256_add_ps(_mm256_loadu_ps(&velocityY[i]), _mm256_and_ps(falling, _mm256_mul_ps(_mm256_loadu_ps(&accelerationY[i]), dt)));
+            __m256 vz = _mm256_add_ps(_mm256_loadu_ps(&velocityZ[i]), _mm256_and_ps(falling, _mm256_mul_ps(_mm256_loadu_ps(&accelerationZ[i]), dt)));
+            vy = _mm256_blendv_ps(vy, zero, grounded);
+
+            _mm256_storeu_ps(&velocityX[i], vx);
+            _mm256_storeu_ps(&velocityY[i], vy);
+            _mm256_storeu_ps(&velocityZ[i], vz);
+        }
+#endif
+
+        for(; i < last; i++)
+        {
+            if((flags[i] & BODY_GRAVITY) && !(flags[i] & (BODY_ON_GROUND | BODY_SLEEPING)))
+            {
+                float dt = deltaTime * timeScale[i];
+                velocityX[i] += accelerationX[i] * dt;
+                velocityY[i] += accelerationY[i] * dt;
+                velocityZ[i] += accelerationZ[i] * dt;
+            }
+
+            if(flags[i] & BODY_ON_GROUND)
+                velocityY[i] = 0.0f;
+        }
+    }
+
+    //second half of integrateBody(), moves the bodies [first, last) with their velocities
+    void integratePositions(float deltaTime, int first = 0, int last = -1)
+    {
+        if(last < 0)
+            last = size();
+
+        int i = first;
+
+#ifdef BODIES_AVX
+        __m256 stepTime = _mm256_set1_ps(deltaTime);
+
+        for(; i + 8 <= last; i += 8)
+        {
+            __m256 dt = _mm256_mul_ps(stepTime, _mm256_loadu_ps(&timeScale[i]));
+            _mm256_storeu_ps(&positionX[i], _mm256_add_ps(_mm256_loadu_ps(&positionX[i]), _mm256_mul_ps(_mm256_loadu_ps(&velocityX[i]), dt)));
+            _mm256_storeu_ps(&positionY[i], _mm256_add_ps(_mm256_loadu_ps(&positionY[i]), _mm256_mul_ps(_mm256_loadu_ps(&velocityY[i]), dt)));
+            _mm256_storeu_ps(&positionZ[i], _mm256_add_ps(_mm256_loadu_ps(&positionZ[i]), _mm256_mul_ps(_mm256_loadu_ps(&velocityZ[i]), dt)));
+        }
+#endif
+
+        for(; i < last; i++)
+        {
+            float dt = deltaTime * timeScale[i];
+            positionX[i] += velocityX[i] * dt;
+            positionY[i] += velocityY[i] * dt;
+            positionZ[i] += velocityZ[i] * dt;
+        }
+    }
+
+    //bytes saveState() writes for count bodies: 14 floats and the flags of each one
+    static size_t stateSize(int count)
+    {
+        return (size_t)count * (14 * sizeof(float) + sizeof(unsigned int));
+    }
+
+    /* copies the per body arrays back to back into data, which has to hold stateSize(size()) bytes.
+    The handles are not part of it, a state only loads into the storage it came from */
+    void saveState(unsigned char *data) const
+    {
+        const std::vector<float> *arrays[14] = {&positionX, &positionY, &positionZ, &velocityX, &velocityY, &velocityZ,
+                                                &accelerationX, &accelerationY, &accelerationZ, &mass, &sleepTimer,
+                                                &previousX, &previousY, &previousZ};
+        size_t bytes = size() * sizeof(float);
+
+        for(int i = 0; i < 14; i++)
+        {
+            std::memcpy(data, arrays[i]->data(), bytes);
+            data += bytes;
+        }
+        std::memcpy(data, flags.data(), size() * sizeof(unsigned int));
+    }
+
+    void loadState(const unsigned char *data)
+    {
+        std::vector<float> *arrays[14] = {&positionX, &positionY, &positionZ, &velocityX, &velocityY, &velocityZ,
+                                          &accelerationX, &accelerationY, &accelerationZ, &mass, &sleepTimer,
+                                          &previousX, &previousY, &previousZ};
+        size_t bytes = size() * sizeof(float);
+
+        for(int i = 0; i < 14; i++)
+        {
+            std::memcpy(arrays[i]->data(), data, bytes);
+            data += bytes;
+        }
+        std::memcpy(flags.data(), data, size() * sizeof(unsigned int));
+    }
+
+    //integrates the bodies at the indices [first, last), same rules as integrateBody()
+    void integrate(float deltaTime, int first = 0, int last = -1)
+    {
+        integrateVelocities(deltaTime, first, last);
+        integratePositions(deltaTime, first, last);
+    }
+};
+
+//bodies of gameObjects that are not part of a physicsWorld
+bodyStorage defaultBodies;
+
+#endif
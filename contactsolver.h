@@ -0,0 +1,309 @@
+#ifndef CONTACTSOLVER_H
+#define CONTACTSOLVER_H
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include <glm/glm.hpp>
+
+#include "game.h"
+
+/* sequential impulse contact solver. Every contact becomes a non penetration constraint that is solved
+iteratively, the accumulated impulse of each contact is kept between steps (keyed by the body pair and
+the contact feature) and applied again at the start of the next step so resting stacks converge in a few
+iterations. Penetration is removed with split impulses: a second impulse per contact acts on pseudo
+velocities that only move the positions, so the correction never adds energy and is not warm started.
+Bodies have no rotation, so a manifold is a single contact with a normal */
+class contactSolver{
+    private:
+    struct constraint{
+        int a, b; // indices into the body storage
+        uint64_t key;
+        glm::vec3 normal; // from a to b
+        float inverseMassA, inverseMassB;
+        float effectiveMass;
+        float bias; // target separating velocity from restitution
+        float positionBias; // target separating pseudo velocity from the penetration
+        float impulse; // accumulated, never negative
+        float positionImpulse;
+    };
+
+    struct cachedImpulse{
+        uint64_t key;
+        float impulse;
+    };
+
+    std::vector<constraint> constraints;
+    std::vector<cachedImpulse> cache; // sorted by key
+    std::vector<cachedImpulse> nextCache;
+
+    //per body velocity of the position correction, indexed like the body storage
+    std::vector<float> pseudoX, pseudoY, pseudoZ;
+
+    int iterations = 8;
+    float baumgarte = 0.2f; // fraction of the penetration removed per step
+    float slop = 0.05f; // penetration that is allowed to stay, keeps resting contacts alive
+    float restitutionThreshold = 1.0f; // slower impacts do not bounce
+    bool warmStarting = true;
+
+    //the axis aligned normals get their own feature so a block sliding off an edge does not reuse the old impulse
+    static int feature(const glm::vec3 &normal)
+    {
+        if(normal.x == 1.0f) return 0;
+        if(normal.x == -1.0f) return 1;
+        if(normal.y == 1.0f) return 2;
+        if(normal.y == -1.0f) return 3;
+        return 4;
+    }
+
+    static uint64_t makeKey(bodyHandle a, bodyHandle b, int feature)
+    {
+        return ((uint64_t)a << 34) | ((uint64_t)b << 3) | (uint64_t)feature;
+    }
+
+    float cachedImpulseOf(uint64_t key)
+    {
+        auto found = std::lower_bound(cache.begin(), cache.end(), key, [](const cachedImpulse &entry, uint64_t k){
+            return entry.key < k;
+        });
+
+        if(found == cache.end() || found->key != key)
+            return 0.0f;
+        return found->impulse;
+    }
+
+    /* bodies without inverse mass are never written: static bodies are left out of the colouring, so every
+    contact against the ground is in the same batch and the workers would all write its velocity at once */
+    void applyImpulse(bodyStorage &bodies, const constraint &c, float impulse)
+    {
+        glm::vec3 p = c.normal * impulse;
+
+        if(c.inverseMassA != 0.0f)
+        {
+            bodies.velocityX[c.a] -= p.x * c.inverseMassA;
+            bodies.velocityY[c.a] -= p.y * c.inverseMassA;
+            bodies.velocityZ[c.a] -= p.z * c.inverseMassA;
+        }
+
+        if(c.inverseMassB != 0.0f)
+        {
+            bodies.velocityX[c.b] += p.x * c.inverseMassB;
+            bodies.velocityY[c.b] += p.y * c.inverseMassB;
+            bodies.velocityZ[c.b] += p.z * c.inverseMassB;
+        }
+    }
+
+    void applyPositionImpulse(const constraint &c, float impulse)
+    {
+        glm::vec3 p = c.normal * impulse;
+
+        if(c.inverseMassA != 0.0f)
+        {
+            pseudoX[c.a] -= p.x * c.inverseMassA;
+            pseudoY[c.a] -= p.y * c.inverseMassA;
+            pseudoZ[c.a] -= p.z * c.inverseMassA;
+        }
+
+        if(c.inverseMassB != 0.0f)
+        {
+            pseudoX[c.b] += p.x * c.inverseMassB;
+            pseudoY[c.b] += p.y * c.inverseMassB;
+            pseudoZ[c.b] += p.z * c.inverseMassB;
+        }
+    }
+
+    float normalVelocity(bodyStorage &bodies, const constraint &c)
+    {
+        glm::vec3 relative(bodies.velocityX[c.b] - bodies.velocityX[c.a],
+                           bodies.velocityY[c.b] - bodies.velocityY[c.a],
+                           bodies.velocityZ[c.b] - bodies.velocityZ[c.a]);
+        return glm::dot(relative, c.normal);
+    }
+
+    public:
+    void setIterations(int iterations)
+    {
+        this->iterations = std::max(1, iterations);
+    }
+
+    int getIterations()
+    {
+        return iterations;
+    }
+
+    void setWarmStarting(bool status)
+    {
+        warmStarting = status;
+    }
+
+    //baumgarte is the fraction of the penetration removed per step, slop the depth that may stay
+    void setCorrection(float baumgarte, float slop)
+    {
+        this->baumgarte = baumgarte;
+        this->slop = slop;
+    }
+
+    //turns the contacts of this step into constraints, contacts[i] becomes constraint i
+    void prepare(const std::vector<contact> &contacts, const std::vector<gameObject*> &objects, bodyStorage &bodies, float deltaTime)
+    {
+        constraints.resize(contacts.size());
+        pseudoX.assign(bodies.size(), 0.0f);
+        pseudoY.assign(bodies.size(), 0.0f);
+        pseudoZ.assign(bodies.size(), 0.0f);
+
+        for(int i = 0, s = contacts.size(); i < s; i++)
+        {
+            const contact &source = contacts[i];
+            gameObject *objA = objects[source.a];
+            gameObject *objB = objects[source.b];
+            constraint &c = constraints[i];
+
+            c.a = bodies.indexOf(objA->getBody());
+            c.b = bodies.indexOf(objB->getBody());
+            c.key = makeKey(objA->getBody(), objB->getBody(), feature(source.result.normal));
+            c.normal = source.result.normal;
+            //bodies the physics LOD paused this step do not move, they push like static ones
+            c.inverseMassA = (objA->getStaticStatus() || bodies.timeScale[c.a] == 0.0f) ? 0.0f : 1.0f / bodies.mass[c.a];
+            c.inverseMassB = (objB->getStaticStatus() || bodies.timeScale[c.b] == 0.0f) ? 0.0f : 1.0f / bodies.mass[c.b];
+
+            float massSum = c.inverseMassA + c.inverseMassB;
+            c.effectiveMass = massSum > 0.0f ? 1.0f / massSum : 0.0f;
+
+            //bounce fast impacts back with the restitution of the pair, push out of the penetration over a few steps
+            float approach = -normalVelocity(bodies, c);
+            float e = std::min(objA->getRestitution(), objB->getRestitution());
+
+            c.bias = approach > restitutionThreshold ? e * approach : 0.0f;
+            c.positionBias = baumgarte / deltaTime * std::max(0.0f, source.result.overlap - slop);
+
+            c.impulse = warmStarting ? cachedImpulseOf(c.key) : 0.0f;
+            c.positionImpulse = 0.0f;
+        }
+    }
+
+    //applies last step's impulses of the constraints order[first, last)
+    void warmStart(bodyStorage &bodies, const int *order, int first, int last)
+    {
+        for(int i = first; i < last; i++)
+        {
+            const constraint &c = constraints[order[i]];
+            if(c.impulse != 0.0f)
+                applyImpulse(bodies, c, c.impulse);
+        }
+    }
+
+    //one iteration over the constraints order[first, last), the accumulated impulse is clamped, not each delta
+    void solve(bodyStorage &bodies, const int *order, int first, int last)
+    {
+        for(int i = first; i < last; i++)
+        {
+            constraint &c = constraints[order[i]];
+
+            float delta = c.effectiveMass * (c.bias - normalVelocity(bodies, c));
+            float accumulated = std::max(0.0f, c.impulse + delta);
+
+            applyImpulse(bodies, c, accumulated - c.impulse);
+            c.impulse = accumulated;
+
+            if(c.positionBias <= 0.0f && c.positionImpulse == 0.0f)
+                continue;
+
+            glm::vec3 relative(pseudoX[c.b] - pseudoX[c.a], pseudoY[c.b] - pseudoY[c.a], pseudoZ[c.b] - pseudoZ[c.a]);
+            delta = c.effectiveMass * (c.positionBias - glm::dot(relative, c.normal));
+            accumulated = std::max(0.0f, c.positionImpulse + delta);
+
+            applyPositionImpulse(c, accumulated - c.positionImpulse);
+            c.positionImpulse = accumulated;
+        }
+    }
+
+    //moves the bodies [first, last) by the position correction of this step
+    void correctPositions(bodyStorage &bodies, float deltaTime, int first = 0, int last = -1)
+    {
+        if(last < 0)
+            last = std::min(bodies.size(), (int)pseudoX.size());
+
+        for(int i = first; i < last; i++)
+        {
+            bodies.positionX[i] += pseudoX[i] * deltaTime;
+            bodies.positionY[i] += pseudoY[i] * deltaTime;
+            bodies.positionZ[i] += pseudoZ[i] * deltaTime;
+        }
+    }
+
+    //keeps the impulses for the next step, contacts that did not come back this step are dropped
+    void store()
+    {
+        nextCache.resize(constraints.size());
+        for(int i = 0, s = constraints.size(); i < s; i++)
+            nextCache[i] = {constraints[i].key, constraints[i].impulse};
+
+        std::sort(nextCache.begin(), nextCache.end(), [](const cachedImpulse &l, const cachedImpulse &r){
+            return l.key < r.key;
+        });
+        cache.swap(nextCache);
+    }
+
+    //same rule as gameObject::collision(), a body resting on a static one is on the ground
+    void updateGroundContacts(const std::vector<contact> &contacts, const std::vector<gameObject*> &objects)
+    {
+        for(const contact &c : contacts)
+        {
+            gameObject *objA = objects[c.a];
+            gameObject *objB = objects[c.b];
+
+            if(objA->getStaticStatus() && !objB->getStaticStatus() && c.result.normal.y > 0.5f && std::abs(objB->getVelocity().y) < 0.1f)
+                objB->setOnGroundStatus(true);
+            else if(objB->getStaticStatus() && !objA->getStaticStatus() && c.result.normal.y < -0.5f && std::abs(objA->getVelocity().y) < 0.1f)
+                objA->setOnGroundStatus(true);
+        }
+    }
+
+    //bytes saveCache() writes, keys first and impulses after them so no padding ends up in a snapshot
+    size_t cacheSize() const
+    {
+        return cache.size() * (sizeof(uint64_t) + sizeof(float));
+    }
+
+    void saveCache(unsigned char *data) const
+    {
+        for(const cachedImpulse &entry : cache)
+        {
+            std::memcpy(data, &entry.key, sizeof(uint64_t));
+            data += sizeof(uint64_t);
+        }
+        for(const cachedImpulse &entry : cache)
+        {
+            std::memcpy(data, &entry.impulse, sizeof(float));
+            data += sizeof(float);
+        }
+    }
+
+    //replaces the warm start impulses with count entries written by saveCache()
+    void loadCache(const unsigned char *data, int count)
+    {
+        cache.resize(count);
+        const unsigned char *impulses = data + count * sizeof(uint64_t);
+
+        for(int i = 0; i < count; i++)
+        {
+            std::memcpy(&cache[i].key, data + i * sizeof(uint64_t), sizeof(uint64_t));
+            std::memcpy(&cache[i].impulse, impulses + i * sizeof(float), sizeof(float));
+        }
+    }
+
+    void clear()
+    {
+        constraints.clear();
+        cache.clear();
+    }
+
+    int getManifoldCount()
+    {
+        return cache.size();
+    }
+};
+
+#endif
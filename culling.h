@@ -0,0 +1,344 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+#include <vector>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define CULLING_SSE
+#endif
+
+#include "game.h"
+
+//the six planes of the view frustum, stored as (normal, distance) pointing inwards
+struct frustum{
+    glm::vec4 planes[6];
+
+    //Gribb-Hartmann plane extraction from a view projection matrix
+    void extract(const glm::mat4 &viewProjection)
+    {
+        glm::vec4 rows[4];
+        for(int i = 0; i < 4; i++)
+            rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+
+        planes[0] = rows[3] + rows[0]; // left
+        planes[1] = rows[3] - rows[0]; // right
+        planes[2] = rows[3] + rows[1]; // bottom
+        planes[3] = rows[3] - rows[1]; // top
+        planes[4] = rows[3] + rows[2]; // near
+        planes[5] = rows[3] - rows[2]; // far
+
+        for(int i = 0; i < 6; i++)
+        {
+            float len = glm::length(glm::vec3(planes[i]));
+            if(len > 0.0f)
+                planes[i] /= len;
+        }
+    }
+
+    bool testSphere(const boundingSphere &sphere) const
+    {
+        for(int i = 0; i < 6; i++)
+        {
+            if(glm::dot(glm::vec3(planes[i]), sphere.center) + planes[i].w < -sphere.radius)
+                return false;
+        }
+        return true;
+    }
+
+    /* returns -1 if the box is outside, 1 if it is completely inside and 0 if it intersects.
+    planeMask holds the planes the parent was already inside of, those are skipped */
+    int testBox(const boundingBox &box, int &planeMask) const
+    {
+        int result = 1;
+        for(int i = 0; i < 6; i++)
+        {
+            if(planeMask & (1 << i)) continue;
+
+            glm::vec3 normal(planes[i]);
+
+            //farthest corner along the plane normal and the one opposite to it
+            glm::vec3 positive(normal.x >= 0 ? box.max.x : box.min.x, normal.y >= 0 ? box.max.y : box.min.y, normal.z >= 0 ? box.max.z : box.min.z);
+            glm::vec3 negative(normal.x >= 0 ? box.min.x : box.max.x, normal.y >= 0 ? box.min.y : box.max.y, normal.z >= 0 ? box.min.z : box.max.z);
+
+            if(glm::dot(normal, positive) + planes[i].w < 0.0f)
+                return -1;
+
+            if(glm::dot(normal, negative) + planes[i].w >= 0.0f)
+                planeMask |= (1 << i);
+            else
+                result = 0;
+        }
+        return result;
+    }
+};
+
+//statistics of the last cull() call
+struct cullingStats{
+    int total = 0;
+    int visible = 0;
+    int nodesVisited = 0;
+};
+
+//visibility system, keeps a bounding volume hierarchy over gameObjects and rejects whole subtrees outside the frustum
+class cullingSystem{
+    private:
+    //leaves hold at most 4 objects so they can be tested with one SSE batch
+    static const int leafSize = 4;
+
+    struct bvhNode{
+        boundingBox box;
+        int left = -1; // right child is always left + 1
+        int start = 0; // first item for leaves
+        int count = 0; // 0 for inner nodes
+    };
+
+    std::vector<gameObject*> objects;
+    std::vector<bvhNode> nodes;
+    std::vector<int> items; // object indices ordered so every leaf is a contiguous range
+    std::vector<boundingBox> boxes;
+
+    //bounding spheres in structure of arrays layout, in the same order as items
+    std::vector<float> sphereX, sphereY, sphereZ, sphereR;
+
+    std::vector<gameObject*> visibleObjects;
+    frustum viewFrustum;
+    cullingStats stats;
+    bool dirty = true;
+
+    static boundingBox merge(const boundingBox &a, const boundingBox &b)
+    {
+        return {glm::min(a.min, b.min), glm::max(a.max, b.max)};
+    }
+
+    //fills the node at index, children are allocated as a pair so only the left index is stored
+    void build(int index, int start, int count)
+    {
+        boundingBox box = boxes[items[start]];
+        boundingBox centroidBox = {(box.min + box.max) * 0.5f, (box.min + box.max) * 0.5f};
+        for(int i = start + 1; i < start + count; i++)
+        {
+            const boundingBox &b = boxes[items[i]];
+            glm::vec3 centroid = (b.min + b.max) * 0.5f;
+            box = merge(box, b);
+            centroidBox = merge(centroidBox, {centroid, centroid});
+        }
+        nodes[index].box = box;
+
+        if(count <= leafSize)
+        {
+            nodes[index].start = start;
+            nodes[index].count = count;
+            return;
+        }
+
+        //median split along the widest axis of the centroids
+        glm::vec3 size = centroidBox.max - centroidBox.min;
+        int axis = (size.x > size.y && size.x > size.z) ? 0 : (size.y > size.z ? 1 : 2);
+        int half = count / 2;
+
+        std::nth_element(items.begin() + start, items.begin() + start + half, items.begin() + start + count, [&](int a, int b){
+            return boxes[a].min[axis] + boxes[a].max[axis] < boxes[b].min[axis] + boxes[b].max[axis];
+        });
+
+        int left = nodes.size();
+        nodes.push_back(bvhNode());
+        nodes.push_back(bvhNode());
+        nodes[index].left = left;
+
+        build(left, start, half);
+        build(left + 1, start + half, count - half);
+    }
+
+    //updates the boxes bottom up, children always have a higher index than their parent
+    void refit()
+    {
+        for(int i = nodes.size() - 1; i >= 0; i--)
+        {
+            bvhNode &node = nodes[i];
+            if(node.count > 0)
+            {
+                node.box = boxes[items[node.start]];
+                for(int j = node.start + 1; j < node.start + node.count; j++)
+                    node.box = merge(node.box, boxes[items[j]]);
+            }
+            else
+            {
+                node.box = merge(nodes[node.left].box, nodes[node.left + 1].box);
+            }
+        }
+    }
+
+    void addRange(int start, int count)
+    {
+        for(int i = start; i < start + count; i++)
+            visibleObjects.push_back(objects[items[i]]);
+    }
+
+    //tests up to 4 spheres of a leaf against the remaining planes at once
+    void testLeaf(const bvhNode &node, int planeMask)
+    {
+#ifdef CULLING_SSE
+        __m128 cx = _mm_loadu_ps(&sphereX[node.start]);
+        __m128 cy = _mm_loadu_ps(&sphereY[node.start]);
+        __m128 cz = _mm_loadu_ps(&sphereZ[node.start]);
+        __m128 negR = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&sphereR[node.start]));
+        __m128 outside = _mm_setzero_ps();
+
+        for(int i = 0; i < 6; i++)
+        {
+            if(planeMask & (1 << i)) continue;
+
+            const glm::vec4 &p = viewFrustum.planes[i];
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(p.x)), _mm_mul_ps(cy, _mm_set1_ps(p.y))),
+                                  _mm_add_ps(_mm_mul_ps(cz, _mm_set1_ps(p.z)), _mm_set1_ps(p.w)));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(d, negR));
+        }
+
+        int mask = _mm_movemask_ps(outside);
+        for(int i = 0; i < node.count; i++)
+        {
+            if(!(mask & (1 << i)))
+                visibleObjects.push_back(objects[items[node.start + i]]);
+        }
+#else
+        for(int i = node.start; i < node.start + node.count; i++)
+        {
+            boundingSphere sphere = {glm::vec3(sphereX[i], sphereY[i], sphereZ[i]), sphereR[i]};
+            if(viewFrustum.testSphere(sphere))
+                visibleObjects.push_back(objects[items[i]]);
+        }
+#endif
+    }
+
+    void traverse(int index, int planeMask)
+    {
+        const bvhNode &node = nodes[index];
+        stats.nodesVisited++;
+
+        int result = viewFrustum.testBox(node.box, planeMask);
+        if(result < 0)
+            return;
+
+        if(node.count > 0)
+        {
+            if(result > 0)
+                addRange(node.start, node.count);
+            else
+                testLeaf(node, planeMask);
+            return;
+        }
+
+        traverse(node.left, planeMask);
+        traverse(node.left + 1, planeMask);
+    }
+
+    public:
+    void addObject(gameObject *objPtr)
+    {
+        objects.push_back(objPtr);
+        dirty = true;
+    }
+
+    void removeObject(gameObject *objPtr)
+    {
+        objects.erase(std::remove(objects.begin(), objects.end(), objPtr), objects.end());
+        dirty = true;
+    }
+
+    void clear()
+    {
+        objects.clear();
+        dirty = true;
+    }
+
+    //rebuilds the hierarchy from scratch, done automatically after objects were added or removed
+    void rebuild()
+    {
+        int size = objects.size();
+
+        nodes.clear();
+        items.resize(size);
+        boxes.resize(size);
+
+        for(int i = 0; i < size; i++)
+        {
+            items[i] = i;
+            boxes[i] = objects[i]->getWorldBounds();
+        }
+
+        if(size > 0)
+        {
+            nodes.reserve(2 * size);
+            nodes.push_back(bvhNode());
+            build(0, 0, size);
+        }
+
+        //padding so the last leaf can always be loaded as 4 floats
+        sphereX.assign(size + leafSize, 0.0f);
+        sphereY.assign(size + leafSize, 0.0f);
+        sphereZ.assign(size + leafSize, 0.0f);
+        sphereR.assign(size + leafSize, 0.0f);
+
+        dirty = false;
+    }
+
+    //returns the objects whose bounds intersect the frustum of the given matrix
+    const std::vector<gameObject*> &cull(const glm::mat4 &viewProjection = projection * view)
+    {
+        if(dirty)
+            rebuild();
+
+        //bounds are cached per object, so this only does work for objects that moved
+        for(int i = 0, s = items.size(); i < s; i++)
+        {
+            gameObject *objPtr = objects[items[i]];
+            boxes[items[i]] = objPtr->getWorldBounds();
+
+            boundingSphere sphere = objPtr->getBoundingSphere();
+            sphereX[i] = sphere.center.x;
+            sphereY[i] = sphere.center.y;
+            sphereZ[i] = sphere.center.z;
+            sphereR[i] = sphere.radius;
+        }
+        refit();
+
+        viewFrustum.extract(viewProjection);
+        visibleObjects.clear();
+
+        stats.total = objects.size();
+        stats.nodesVisited = 0;
+
+        if(!nodes.empty())
+            traverse(0, 0);
+
+        stats.visible = visibleObjects.size();
+        return visibleObjects;
+    }
+
+    void drawVisible(light lightSource, glm::vec3 cameraPos)
+    {
+        for(gameObject *objPtr : visibleObjects)
+            objPtr->draw(lightSource, cameraPos);
+    }
+
+    cullingStats getStats()
+    {
+        return stats;
+    }
+
+    int getVisibleCount()
+    {
+        return stats.visible;
+    }
+
+    int getTotalCount()
+    {
+        return stats.total;
+    }
+};
+
+#endif
@@ -0,0 +1,574 @@
+#ifndef ECS_H
+#define ECS_H
+
+#include <vector>
+#include <tuple>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+#include <type_traits>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "game.h"
+#include "hierarchy.h"
+
+/* archetype based entity component system. Every entity with the same set of components lives in the same
+archetype, which keeps one packed array per component, so a system that asks for transforms and bodies walks
+a few arrays from front to back instead of jumping between gameObjects. Components are plain data and are
+moved with memcpy when an entity gains or loses one.
+
+The existing classes keep working: attachObject() mirrors a gameObject into an entity, syncObjects() copies
+what changed on the objects every frame, and the bodies stay in their bodyStorage, the rigid body component
+only holds the handle. A level can move over to entities one system at a time */
+
+//stable id of an entity, reused after destroy() like body handles
+typedef int entity;
+const entity NO_ENTITY = -1;
+
+//components
+struct transformComponent{
+    glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f);
+    glm::mat4 local = glm::mat4(1.0f); // matrix set by the user, the model matrix of a gameObject
+    glm::mat4 world = glm::mat4(1.0f); // translate(position) * local, rebuilt by updateTransforms()
+};
+
+//the body itself stays in the storage so physicsWorld keeps integrating it in one batch
+struct rigidBodyComponent{
+    bodyStorage *storage = &defaultBodies;
+    bodyHandle body = NO_BODY;
+    float restitution = 1.0f;
+};
+
+struct colliderComponent{
+    int shape = SHAPE_AABB;
+    boundingBox local; // bounds of the mesh
+    float radius = 0.0f;
+    float halfHeight = 0.0f;
+};
+
+struct meshComponent{
+    model *mesh = NULL;
+    bool isCircle = false;
+};
+
+struct renderComponent{
+    glm::vec4 color = glm::vec4(1.0f);
+    glm::vec4 highlightColor = glm::vec4(1.0f);
+    bool visible = true;
+};
+
+struct playerInputComponent{
+    float jumpBuffer = 0.0f; // time a requested jump stays valid while in the air
+    float jumpSpeed = JUMP_SPEED;
+    float moveStep = 2.0f; // distance moved per frame a key is held
+};
+
+//node in a transformHierarchy the entity hangs under, for entities without a rigid body
+struct hierarchyComponent{
+    transformHierarchy *tree = NULL;
+    transformHandle node = NO_TRANSFORM;
+};
+
+//back link of entities made by attachObject()
+struct objectComponent{
+    gameObject *object = NULL;
+};
+
+//ids are handed out the first time a component type is used, the mask of an archetype has one bit per id
+const int MAX_COMPONENT_TYPES = 32;
+
+inline int newComponentId()
+{
+    static int next = 0;
+    return next++;
+}
+
+template<typename T>
+int componentId()
+{
+    static_assert(std::is_trivially_copyable<T>::value, "components are moved with memcpy");
+    static int id = newComponentId();
+    return id;
+}
+
+class entityRegistry{
+    private:
+    struct column{
+        int component;
+        size_t size; // bytes per entity
+        std::vector<unsigned char> data;
+    };
+
+    struct archetype{
+        uint32_t mask = 0;
+        std::vector<entity> entities;
+        std::vector<column> columns; // sorted by component id
+        int columnOf[MAX_COMPONENT_TYPES]; // component id -> column, -1 when the archetype does not have it
+
+        template<typename T>
+        T *array()
+        {
+            return reinterpret_cast<T*>(columns[columnOf[componentId<T>()]].data.data());
+        }
+    };
+
+    struct entityRecord{
+        int type; // archetype, -1 for free ids
+        int row;
+    };
+
+    std::vector<archetype> archetypes; // archetype 0 is the one without components
+    std::vector<entityRecord> records;
+    std::vector<entity> freeEntities;
+    size_t componentSizes[MAX_COMPONENT_TYPES] = {};
+
+    template<typename T>
+    static uint32_t bitOf()
+    {
+        int id = componentId<T>();
+        if(id >= MAX_COMPONENT_TYPES)
+        {
+            std::cout << "ERROR::ECS::TOO_MANY_COMPONENT_TYPES\n";
+            std::abort();
+        }
+        return 1u << id;
+    }
+
+    template<typename... T>
+    static uint32_t maskOf()
+    {
+        uint32_t mask = 0;
+        for(uint32_t bit : {0u, bitOf<T>()...})
+            mask |= bit;
+        return mask;
+    }
+
+    int findArchetype(uint32_t mask)
+    {
+        for(int i = 0, s = archetypes.size(); i < s; i++)
+        {
+            if(archetypes[i].mask == mask)
+                return i;
+        }
+
+        archetype type;
+        type.mask = mask;
+        for(int id = 0; id < MAX_COMPONENT_TYPES; id++)
+        {
+            type.columnOf[id] = -1;
+            if(mask & (1u << id))
+            {
+                type.columnOf[id] = type.columns.size();
+                type.columns.push_back({id, componentSizes[id], {}});
+            }
+        }
+
+        archetypes.push_back(type);
+        return archetypes.size() - 1;
+    }
+
+    //takes the row out of its archetype, the last row moves into the hole
+    void removeRow(int typeIndex, int row)
+    {
+        archetype &type = archetypes[typeIndex];
+        int last = type.entities.size() - 1;
+
+        if(row != last)
+        {
+            for(column &c : type.columns)
+                std::memcpy(&c.data[row * c.size], &c.data[last * c.size], c.size);
+
+            type.entities[row] = type.entities[last];
+            records[type.entities[row]].row = row;
+        }
+
+        for(column &c : type.columns)
+            c.data.resize(last * c.size);
+        type.entities.pop_back();
+    }
+
+    //moves the entity into the archetype of mask, components both archetypes have are copied over
+    void moveEntity(entity e, uint32_t mask)
+    {
+        entityRecord &record = records[e];
+        int target = findArchetype(mask);
+
+        archetype &from = archetypes[record.type];
+        archetype &to = archetypes[target];
+        int row = to.entities.size();
+
+        to.entities.push_back(e);
+        for(column &c : to.columns)
+        {
+            c.data.resize((row + 1) * c.size);
+
+            int source = from.columnOf[c.component];
+            if(source >= 0)
+                std::memcpy(&c.data[row * c.size], &from.columns[source].data[record.row * c.size], c.size);
+        }
+
+        removeRow(record.type, record.row);
+        record.type = target;
+        record.row = row;
+    }
+
+    public:
+    entityRegistry()
+    {
+        findArchetype(0);
+    }
+
+    entity create()
+    {
+        entity e;
+        if(!freeEntities.empty())
+        {
+            e = freeEntities.back();
+            freeEntities.pop_back();
+        }
+        else
+        {
+            e = records.size();
+            records.push_back({-1, 0});
+        }
+
+        records[e] = {0, (int)archetypes[0].entities.size()};
+        archetypes[0].entities.push_back(e);
+        return e;
+    }
+
+    //bodies are not destroyed with the entity, see removeBody()
+    void destroy(entity e)
+    {
+        if(!alive(e))
+            return;
+
+        removeRow(records[e].type, records[e].row);
+        records[e].type = -1;
+        freeEntities.push_back(e);
+    }
+
+    bool alive(entity e)
+    {
+        return e >= 0 && e < (int)records.size() && records[e].type >= 0;
+    }
+
+    //adds the component or overwrites it when the entity already has one
+    template<typename T>
+    T &add(entity e, const T &component = T())
+    {
+        uint32_t bit = bitOf<T>();
+        componentSizes[componentId<T>()] = sizeof(T);
+
+        if(!(archetypes[records[e].type].mask & bit))
+            moveEntity(e, archetypes[records[e].type].mask | bit);
+
+        T *value = &archetypes[records[e].type].array<T>()[records[e].row];
+        *value = component;
+        return *value;
+    }
+
+    template<typename T>
+    void remove(entity e)
+    {
+        uint32_t bit = bitOf<T>();
+        if(archetypes[records[e].type].mask & bit)
+            moveEntity(e, archetypes[records[e].type].mask & ~bit);
+    }
+
+    template<typename T>
+    bool has(entity e)
+    {
+        return alive(e) && (archetypes[records[e].type].mask & bitOf<T>());
+    }
+
+    //NULL when the entity does not have the component, the pointer is only valid until components are added or removed
+    template<typename T>
+    T *get(entity e)
+    {
+        if(!has<T>(e))
+            return NULL;
+        return &archetypes[records[e].type].array<T>()[records[e].row];
+    }
+
+    /* calls function(entity, T&...) for every entity that has all of the components, archetype by archetype
+    over the packed arrays. Components must not be added or removed inside the loop */
+    template<typename... T, typename F>
+    void forEach(F function)
+    {
+        uint32_t mask = maskOf<T...>();
+
+        for(archetype &type : archetypes)
+        {
+            if((type.mask & mask) != mask || type.entities.empty())
+                continue;
+
+            std::tuple<T*...> arrays(type.template array<T>()...);
+            const entity *entities = type.entities.data();
+
+            for(int i = 0, s = type.entities.size(); i < s; i++)
+                function(entities[i], std::get<T*>(arrays)[i]...);
+        }
+    }
+
+    //same as forEach() but hands over whole arrays, function(count, entities, T*...), for loops that want to vectorize
+    template<typename... T, typename F>
+    void forEachChunk(F function)
+    {
+        uint32_t mask = maskOf<T...>();
+
+        for(archetype &type : archetypes)
+        {
+            if((type.mask & mask) != mask || type.entities.empty())
+                continue;
+
+            function((int)type.entities.size(), (const entity*)type.entities.data(), type.template array<T>()...);
+        }
+    }
+
+    //entities that have all of the components
+    template<typename... T>
+    int count()
+    {
+        uint32_t mask = maskOf<T...>();
+        int result = 0;
+        for(archetype &type : archetypes)
+        {
+            if((type.mask & mask) == mask)
+                result += type.entities.size();
+        }
+        return result;
+    }
+
+    int getArchetypeCount()
+    {
+        return archetypes.size();
+    }
+
+    void clear()
+    {
+        archetypes.resize(1);
+        archetypes[0].entities.clear();
+        records.clear();
+        freeEntities.clear();
+    }
+};
+
+//creates a body in storage and gives the entity a rigid body component for it
+inline rigidBodyComponent &addBody(entityRegistry &registry, entity e, const bodyState &state = bodyState(), bodyStorage *storage = &defaultBodies)
+{
+    rigidBodyComponent component;
+    component.storage = storage;
+    component.body = storage->create(state);
+    return registry.add<rigidBodyComponent>(e, component);
+}
+
+//destroys the body created by addBody(), bodies of attached objects belong to the object
+inline void removeBody(entityRegistry &registry, entity e)
+{
+    rigidBodyComponent *component = registry.get<rigidBodyComponent>(e);
+    if(component == NULL)
+        return;
+
+    if(!registry.has<objectComponent>(e))
+        component->storage->destroy(component->body);
+    registry.remove<rigidBodyComponent>(e);
+}
+
+//migration shim: an entity that mirrors the object, the object stays the owner of its body and mesh
+inline entity attachObject(entityRegistry &registry, gameObject *objPtr)
+{
+    entity e = registry.create();
+    registry.add<objectComponent>(e, {objPtr});
+
+    transformComponent transform;
+    transform.position = objPtr->getPosition();
+    transform.local = objPtr->getModelMatrix();
+    transform.world = objPtr->getWorldMatrix();
+    registry.add<transformComponent>(e, transform);
+
+    rigidBodyComponent body;
+    body.storage = objPtr->getBodyStorage();
+    body.body = objPtr->getBody();
+    body.restitution = objPtr->getRestitution();
+    registry.add<rigidBodyComponent>(e, body);
+
+    colliderComponent collider;
+    collider.shape = objPtr->getColliderType();
+    collider.local = objPtr->getLocalBounds();
+    registry.add<colliderComponent>(e, collider);
+
+    registry.add<meshComponent>(e, {objPtr->getMesh(), objPtr->getCircleStatus()});
+    registry.add<renderComponent>(e, {objPtr->getColor(), objPtr->getMesh()->getHighlightColor(), true});
+
+    if(dynamic_cast<player*>(objPtr) != NULL)
+        registry.add<playerInputComponent>(e);
+
+    return e;
+}
+
+/* copies the state that lives on the objects into their entities: the body handle changes when a physicsWorld
+takes the object, the model matrix and colors are set through the object. Call once per frame before the systems */
+inline void syncObjects(entityRegistry &registry)
+{
+    registry.forEach<objectComponent, rigidBodyComponent, transformComponent, renderComponent>(
+        [](entity, objectComponent &link, rigidBodyComponent &body, transformComponent &transform, renderComponent &render){
+            gameObject *objPtr = link.object;
+
+            body.storage = objPtr->getBodyStorage();
+            body.body = objPtr->getBody();
+            body.restitution = objPtr->getRestitution();
+            transform.local = objPtr->getModelMatrix();
+            render.color = objPtr->getColor();
+            render.highlightColor = objPtr->getMesh()->getHighlightColor();
+        });
+}
+
+//systems
+
+//positions between the last two fixed steps and the matrices drawn with them
+inline void updateTransforms(entityRegistry &registry)
+{
+    registry.forEach<rigidBodyComponent, transformComponent>([](entity, rigidBodyComponent &body, transformComponent &transform){
+        transform.position = body.storage->getRenderPosition(body.body);
+        transform.world = glm::translate(glm::mat4(1.0f), transform.position) * transform.local;
+    });
+}
+
+//world matrices of entities in a hierarchy, run after transformHierarchy::update()
+inline void applyHierarchy(entityRegistry &registry)
+{
+    registry.forEach<hierarchyComponent, transformComponent>([](entity, hierarchyComponent &link, transformComponent &transform){
+        transform.world = link.tree->getWorldMatrix(link.node) * transform.local;
+        transform.position = glm::vec3(transform.world[3]);
+    });
+}
+
+/* same keys as player::movements() and a jump request on space, once per frame. Attached players are moved
+by their own movements() and applyPlayerInput() skips them, so their jump goes to player::jump() */
+inline void readPlayerInput(entityRegistry &registry, GLFWwindow *window)
+{
+    registry.forEach<playerInputComponent, rigidBodyComponent>([&](entity e, playerInputComponent &input, rigidBodyComponent &body){
+        objectComponent *link = registry.get<objectComponent>(e);
+        if(link != NULL)
+        {
+            if(glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS)
+                static_cast<player*>(link->object)->jump();
+            return;
+        }
+
+        glm::vec3 move(0.0f);
+        if(glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) move.y += input.moveStep;
+        if(glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) move.y -= input.moveStep;
+        if(glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) move.x += input.moveStep;
+        if(glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) move.x -= input.moveStep;
+
+        if(move != glm::vec3(0.0f))
+        {
+            body.storage->setPosition(body.body, body.storage->getPosition(body.body) + move);
+            body.storage->wake(body.body);
+        }
+
+        if(glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS)
+            input.jumpBuffer = JUMP_BUFFER_TIME;
+    });
+}
+
+/* player::fixedUpdate() for entities, run before the bodies are integrated. Attached players are skipped,
+their object already runs it */
+inline void applyPlayerInput(entityRegistry &registry, float deltaTime)
+{
+    registry.forEach<playerInputComponent, rigidBodyComponent>([&](entity e, playerInputComponent &input, rigidBodyComponent &body){
+        if(input.jumpBuffer <= 0.0f || registry.has<objectComponent>(e))
+            return;
+
+        if(body.storage->getFlag(body.body, BODY_ON_GROUND))
+        {
+            glm::vec3 velocity = body.storage->getVelocity(body.body);
+            velocity.y = input.jumpSpeed;
+            body.storage->setVelocity(body.body, velocity);
+            body.storage->setFlag(body.body, BODY_ON_GROUND, false);
+            input.jumpBuffer = 0.0f;
+        }
+        else
+            input.jumpBuffer -= deltaTime;
+    });
+}
+
+//gameObject::record() for every visible entity with a mesh, run after updateTransforms()
+inline void recordEntities(entityRegistry &registry, commandBuffer &buffer)
+{
+    registry.forEach<transformComponent, meshComponent, renderComponent>([&buffer](entity, transformComponent &transform, meshComponent &mesh, renderComponent &render){
+        if(!render.visible || mesh.mesh == NULL)
+            return;
+
+        renderCommand command;
+        command.mesh = mesh.mesh;
+        command.data = {transform.world, render.color, render.highlightColor};
+        command.isCircle = mesh.isCircle;
+        buffer.commands.push_back(command);
+    });
+}
+
+struct ecsBenchmarkResult{
+    double objectTime = 0.0; // milliseconds per pass over the gameObjects
+    double entityTime = 0.0; // milliseconds per pass of updateTransforms() over the same bodies
+    float checksum = 0.0f; // sum of what both loops read, returned so they are not optimized away
+};
+
+/* cost of rebuilding the render matrices of count objects through the gameObjects and through their
+entities. The objects are created in a shuffled order so they do not sit next to each other in memory,
+which is what a level that was built and edited over time looks like */
+inline ecsBenchmarkResult benchmarkEntities(int count = 10000, int passes = 100)
+{
+    std::vector<gameObject*> objects(count);
+    std::vector<int> order(count);
+    for(int i = 0; i < count; i++)
+        order[i] = i;
+
+    srand(1);
+    for(int i = count - 1; i > 0; i--)
+        std::swap(order[i], order[rand() % (i + 1)]);
+
+    for(int i : order)
+    {
+        objects[i] = new gameObject();
+        objects[i]->setPosition(glm::vec3(rand() % 1000, rand() % 1000, 0.0f));
+    }
+
+    entityRegistry registry;
+    for(gameObject *objPtr : objects)
+        attachObject(registry, objPtr);
+
+    float sum = 0.0f;
+    auto start = std::chrono::steady_clock::now();
+    for(int pass = 0; pass < passes; pass++)
+    {
+        for(gameObject *objPtr : objects)
+            sum += objPtr->getRenderMatrix()[3][0];
+    }
+    auto middle = std::chrono::steady_clock::now();
+    for(int pass = 0; pass < passes; pass++)
+    {
+        updateTransforms(registry);
+        registry.forEachChunk<transformComponent>([&sum](int size, const entity*, transformComponent *transforms){
+            sum += transforms[size - 1].world[3][0];
+        });
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    for(gameObject *objPtr : objects)
+        delete objPtr;
+
+    ecsBenchmarkResult result;
+    result.checksum = sum;
+    result.objectTime = std::chrono::duration<double, std::milli>(middle - start).count() / passes;
+    result.entityTime = std::chrono::duration<double, std::milli>(end - middle).count() / passes;
+    return result;
+}
+
+#endif
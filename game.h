@@ -1,3 +1,6 @@
+#ifndef GAME_H
+#define GAME_H
+
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <vector>
@@ -15,8 +18,15 @@
 #include <glm/gtc/random.hpp>
 
 #include "shader.h"
+#include "glresource.h"
+#include "memory.h"
+#include "ringbuffer.h"
+#include "bodies.h"
+#include "narrowphase.h"
 
 const glm::vec3 GRAVITY(0.0f, -70.0f, 0.0f);
+const float JUMP_SPEED = 85.0f;
+const float JUMP_BUFFER_TIME = 0.1f; // seconds a jump pressed before landing is remembered
 
 bool is3D = false;
 
@@ -28,6 +38,7 @@ std::vector<float> heightMap;
 std::vector <float> perlin(int length, int gridSize, float amplitude)
 {
     std::vector <float> heightMap;
+    heightMap.reserve(length * length);
 
     int angles[gridSize * gridSize];
     for(int i = 0, s = gridSize * gridSize; i < s; i++)
@@ -89,9 +100,10 @@ std::vector <float> perlin(int length, int gridSize, float amplitude)
     return heightMap;
 }
 
-std::vector<float> add(std::vector<float> v1, std::vector<float> v2)
+std::vector<float> add(const std::vector<float> &v1, const std::vector<float> &v2)
 {
     std::vector<float> result;
+    result.reserve(v1.size());
 
     for(int i = 0,s = v1.size(); i < s; i++)
     {
@@ -115,21 +127,11 @@ struct light{
     // float attenuation;
 };
 
-//struct that stores all the stuffs needed to implement physics
+/* collider and material data of an object. Position, velocity, acceleration, mass and the
+gravity/ground/collision/static flags live in a bodyStorage (bodies.h) and are reached through the body handle */
 struct physicsComponent{
-    float mass = 1.0;
-    glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f); //object center
-    glm::vec3 velocity = glm::vec3(0.0f, 0.0f, 0.0f);
-    glm::vec3 acceleration = glm::vec3(0.0f, 0.0f, 0.0f);
-
-    //For Gravity:
-    bool hasGravity = false;
-    bool onGround = false;
-
     //For Collision:
-    bool hasCollision = false;
     float coeffOfRestitution = 1.0;
-    bool isStatic = false;
 
     //AABB Collision
     bool isAABB = false;
@@ -137,14 +139,11 @@ struct physicsComponent{
     //spherical collision
     bool isSpherical = false;
     float radius = 0.0f;
-};
 
-/* struct used in collision system to know the if collision has occured,
-the overlap between the colliding objects and the collision normal */
-struct collided{
-    bool hasCollided = false;
-    float overlap = 0.0f;
-    glm::vec3 normal = glm::vec3(0.0f, 0.0f, 0.0f);
+    //collider the narrowphase uses, one of shapeType (narrowphase.h)
+    int shape = SHAPE_AABB;
+    float halfHeight = 0.0f; // capsules, along the local y axis
+    std::vector<glm::vec3> hull; // convex colliders, local space
 };
 
 // camera class which stores and updates the camera system
@@ -218,13 +217,17 @@ class model{
     // std::vector<float> flatVertices;
     // std::vector<float>flatNormals;
     std::ifstream file;
-    shader *modelShader;
+    shader *modelShader = NULL;
+    ringBuffer *drawBuffer = NULL; // per draw data goes here instead of uniforms when set
     glm::vec4 color;
     glm::vec4 highlightColor;
-    unsigned int VBO_position, VBO_normal, VAO, EBO;
-    unsigned int VAO_Flat, VBO_FlatPosition, VBO_FlatShadingNormal;
-    bool flatShading;
-    int flatVerticesSize;
+    glBuffer VBO_position, VBO_normal, EBO;
+    glVertexArray VAO;
+    glBuffer VBO_FlatPosition, VBO_FlatShadingNormal;
+    glVertexArray VAO_Flat;
+    bool flatShading = false;
+    int flatVerticesSize = 0;
+    int gridParts = 0; // vertices per row for meshes built by sheet3D
 
     //std::vector<float>vertexTestures;
     public:
@@ -233,27 +236,23 @@ class model{
         color = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
     }
 
+    //the GL objects are owned by their handles, so a model can be moved into a container but never copied
+    model(const model&) = delete;
+    model &operator=(const model&) = delete;
+    model(model&&) = default;
+    model &operator=(model&&) = default;
+
     void attachBuffers()
     {
-         // Delete previous if already generated
-        if (glIsVertexArray(VAO))
-            glDeleteVertexArrays(1, &VAO);
-        if (glIsBuffer(VBO_position))
-            glDeleteBuffers(1, &VBO_position);
-        if (glIsBuffer(VBO_normal))
-            glDeleteBuffers(1, &VBO_position);
-        if (glIsBuffer(EBO))
-            glDeleteBuffers(1, &EBO);
-
-
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO_position);
-        glGenBuffers(1, &EBO);
+        // create() deletes the previous objects if the mesh was already uploaded
+        VAO.create();
+        VBO_position.create();
+        EBO.create();
         // bind the Vertex Array Object first, then bind and set vertex buffer(s), and then configure vertex attributes(s).
-        glBindVertexArray(VAO);
+        glBindVertexArray(VAO.get());
 
         //Positions
-        glBindBuffer(GL_ARRAY_BUFFER, VBO_position);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO_position.get());
         glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
         glEnableVertexAttribArray(0);
@@ -261,15 +260,18 @@ class model{
         if(is3D)
         {
             //Normals
-            glGenBuffers(1, &VBO_normal);
-            glBindBuffer(GL_ARRAY_BUFFER, VBO_normal);
+            VBO_normal.create();
+            glBindBuffer(GL_ARRAY_BUFFER, VBO_normal.get());
             glBufferData(GL_ARRAY_BUFFER, vertexNormals.size() * sizeof(float), vertexNormals.data(), GL_STATIC_DRAW);
             glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
             glEnableVertexAttribArray(1);
         }
 
+        else
+            VBO_normal.reset();
+
         //Indices
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO.get());
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, faces.size() * sizeof(int), faces.data(), GL_STATIC_DRAW);
 
         // note that this is allowed, the call to glVertexAttribPointer registered VBO as the vertex attribute's bound vertex buffer object so afterwards we can safely unbind
@@ -407,6 +409,7 @@ class model{
         flatShading = true;
 
         int parts = subdivisions + 2;
+        gridParts = parts;
 
         float partLength = length/(parts - 1);
         float partBreadth = breadth/(parts - 1);
@@ -541,9 +544,10 @@ class model{
     //     }
     // }
 
-    std::vector<float> applyTranslation(std::vector<float> verts, glm::vec3 position)
+    std::vector<float> applyTranslation(const std::vector<float> &verts, glm::vec3 position)
     {
         std::vector<float> transformedVerts;
+        transformedVerts.reserve(verts.size());
         for(int i = 0, s = verts.size()/3; i < s; i++)
         {
             transformedVerts.push_back(verts[3 * i + 0] + position.x);
@@ -554,26 +558,34 @@ class model{
         return transformedVerts;
     }
 
-    std::vector<float> applyMatrix(std::vector<float> verts, glm::mat4 matrix)
+    std::vector<float> applyMatrix(const std::vector<float> &verts, glm::mat4 matrix)
     {
         std::vector<float> transformedVerts;
+        appendMatrix(verts, matrix, transformedVerts);
+        return transformedVerts;
+    }
+
+    //appends the transformed vertices to out, any container of floats (frameVector for scratch memory)
+    template<typename IN, typename OUT>
+    void appendMatrix(const IN &verts, glm::mat4 matrix, OUT &out)
+    {
+        out.reserve(out.size() + verts.size());
         for(int i = 0, s = verts.size()/3; i < s; i++)
         {
             glm::vec4 point(verts[3 * i + 0], verts[3 * i + 1], verts[3 * i + 2], 1.0f);
 
             point = matrix * point;
 
-            transformedVerts.push_back(point.x);
-            transformedVerts.push_back(point.y);
-            transformedVerts.push_back(point.z);
+            out.push_back(point.x);
+            out.push_back(point.y);
+            out.push_back(point.z);
         }
-
-        return transformedVerts;
     }
 
-    std::vector<int> applyOffset(std::vector<int> indices, int offset, int vertCount)
+    std::vector<int> applyOffset(const std::vector<int> &indices, int offset, int vertCount)
     {
         std::vector<int> finalIndices;
+        finalIndices.reserve(indices.size());
         for(int i = 0, s = indices.size(); i < s; i++)
         {
             finalIndices.push_back(indices[i] + vertCount / 3 * offset);
@@ -588,14 +600,22 @@ class model{
         return u * u * p0 + 2.0f * u * t * p1 + t * t * p2;
     }
 
-    std::vector<float> applyCurvature(std::vector<float> verts)
+    std::vector<float> applyCurvature(const std::vector<float> &verts)
+    {
+        std::vector<float> curvedVerts;
+        applyCurvature(verts, curvedVerts);
+        return curvedVerts;
+    }
+
+    template<typename OUT>
+    void applyCurvature(const std::vector<float> &verts, OUT &curvedVerts)
     {
         int size = verts.size() / 3 - 1;
         glm::vec3 p0(0.0f);
         glm::vec3 p1(0, (float) (rand() % 6), 8 + (float)(rand() % 5));
         glm::vec3 p2(0, - (float)(4 + rand() % 5), 25);
 
-        std::vector<float> curvedVerts;
+        curvedVerts.reserve(curvedVerts.size() + verts.size());
 
         for(int i = 0; i <= size; i++)
         {
@@ -607,8 +627,6 @@ class model{
             curvedVerts.push_back(verts[3 * i + 1] + curved.y);
             curvedVerts.push_back(verts[3 * i + 2]);
         }
-
-        return curvedVerts;
     }
 
     void grass(float size, int grid)
@@ -757,6 +775,11 @@ class model{
             16, 17, 18 // Right tip
         };
 
+        //every blade is curved in scratch memory and appended, so the field does not allocate per blade
+        vertices.reserve(vertices.size() + grid * grid * grassVertex.size());
+        faces.reserve(faces.size() + grid * grid * grassIndices.size());
+        frameArena scratch(2 * grassVertex.size() * sizeof(float));
+
         float spacing = size / grid;
         for(int i = 0; i < grid; i++)
         {
@@ -773,13 +796,15 @@ class model{
                 glm::mat4 grassMatrix(1.0f);
                 grassMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(i * spacing + spacing/2 + randomnessX, j * spacing + spacing/2 + randomnessY,0 /*heightMap[size * j + i]*/)) * glm::rotate(glm::mat4(1.0f), glm::radians((float)(rand() % 360)), glm::vec3(0.0f, 0.0f, 1.0f)) * glm::scale(glm::mat4(1.0f), glm::vec3(1.0f, 1.0f, ((float) ((rand() % 11) / 15) + 0.6)));
                 // std::vector<float> transformed = applyTranslation(grassVertex, glm::vec3(j * spacing + spacing/2 + randomnessX, i * spacing + spacing/2 + randomnessY, 0));
-                std::vector<float> transformed = applyMatrix(applyCurvature(grassVertex), grassMatrix);
-                vertices.insert(vertices.end(), transformed.begin(), transformed.end());
+                int firstVertex = vertices.size() / 3; // the blade's indices start at its own first vertex
+
+                scratch.reset();
+                frameVector<float> curved(&scratch);
+                applyCurvature(grassVertex, curved);
+                appendMatrix(curved, grassMatrix, vertices);
 
-                int currentVertexCount = vertices.size(); // in floats
-                std::vector<int> offsetIndices = applyOffset(grassIndices, 1, currentVertexCount);  // offset=1 since vertCount already accounts for total
-                // std::vector<int> offsetIndices = applyOffset(grassIndices, grid * i + k, grassVertex.size());
-                faces.insert(faces.end(), offsetIndices.begin(), offsetIndices.end());
+                for(int index : grassIndices)
+                    faces.push_back(index + firstVertex);
             }
         }
         calculateNormals();
@@ -899,20 +924,20 @@ class model{
 
         flatVerticesSize = flatVertices.size();
 
-        glGenVertexArrays(1, &VAO_Flat);
-        glGenBuffers(1, &VBO_FlatPosition);
-        glGenBuffers(1, &VBO_FlatShadingNormal);
+        VAO_Flat.create();
+        VBO_FlatPosition.create();
+        VBO_FlatShadingNormal.create();
 
         // bind the Vertex Array Object first, then bind and set vertex buffer(s), and then configure vertex attributes(s).
-        glBindVertexArray(VAO_Flat);
+        glBindVertexArray(VAO_Flat.get());
 
-        glBindBuffer(GL_ARRAY_BUFFER, VBO_FlatPosition);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO_FlatPosition.get());
         glBufferData(GL_ARRAY_BUFFER, flatVertices.size() * sizeof(float), flatVertices.data(), GL_STATIC_DRAW);
 
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
         glEnableVertexAttribArray(0);
 
-        glBindBuffer(GL_ARRAY_BUFFER, VBO_FlatShadingNormal);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO_FlatShadingNormal.get());
         glBufferData(GL_ARRAY_BUFFER, flatNormals.size() * sizeof(float), flatNormals.data(), GL_STATIC_DRAW);
 
         glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
@@ -937,12 +962,33 @@ class model{
         this->highlightColor = color;
     }
 
+    //ring buffer shared by all models, the game loop calls beginFrame()/endFrame() on it
+    void setDrawBuffer(ringBuffer *drawBuffer)
+    {
+        this->drawBuffer = drawBuffer;
+    }
+
     //get function to get different values from the class
     glm::vec4 getColor()
     {
         return color;
     }
 
+    glm::vec4 getHighlightColor()
+    {
+        return highlightColor;
+    }
+
+    const std::vector<float> &getVertices()
+    {
+        return vertices;
+    }
+
+    int getGridSize()
+    {
+        return gridParts;
+    }
+
     float getAverageVertices()
     {
         float average = 0;
@@ -998,12 +1044,12 @@ class model{
     {
         if(is3D && flatShading)
         {
-            glBindVertexArray(VAO_Flat);
+            glBindVertexArray(VAO_Flat.get());
             glDrawArrays(GL_TRIANGLES, 0, flatVerticesSize/3);
         }
         else
         {
-            glBindVertexArray(VAO); // seeing as we only have a single VAO there's no need to bind it every time, but we'll do so to keep things a bit more organized
+            glBindVertexArray(VAO.get()); // seeing as we only have a single VAO there's no need to bind it every time, but we'll do so to keep things a bit more organized
             //glDrawArrays(GL_TRIANGLES, 0, 6);
             if(isCircle)
                 glDrawElements(GL_TRIANGLE_FAN, faces.size(), GL_UNSIGNED_INT, 0);
@@ -1012,41 +1058,88 @@ class model{
         }
     }
 
-    void useShader(glm::mat4 model, light lightSource = {glm::vec3(0.0f), glm::vec4(0.0f), 0.0f}, glm::vec3 cameraPosition = glm::vec3(0.0f))
+    //returns false if neither the shader nor its fallback finished compiling, the model is skipped then
+    bool useShader(glm::mat4 model, light lightSource = {glm::vec3(0.0f), glm::vec4(0.0f), 0.0f}, glm::vec3 cameraPosition = glm::vec3(0.0f))
     {
-        modelShader->use();
+        drawData data = {model, color, highlightColor};
+        return useShader(data, view, projection, lightSource, cameraPosition);
+    }
+
+    //same as above but everything comes from the caller, used when replaying recorded frames
+    bool useShader(const drawData &data, const glm::mat4 &viewMatrix, const glm::mat4 &projectionMatrix, light lightSource, glm::vec3 cameraPosition)
+    {
+        shader *activeShader = modelShader->getActive();
+        if(!activeShader)
+            return false;
+
+        activeShader->use();
 
-        modelShader->setMat4("model", model);
-        modelShader->setMat4("view", view);
-        modelShader->setMat4("projection", projection);
-        modelShader->setVec3("baseColor", glm::vec3(color));
-        modelShader->setVec3("highlightColor", glm::vec3(highlightColor));
+        activeShader->setMat4("view", viewMatrix);
+        activeShader->setMat4("projection", projectionMatrix);
+
+        //one buffer range bind instead of a uniform call for every value, if the shader has the block
+        bool pushed = false;
+        if(drawBuffer && drawBuffer->isValid() && activeShader->bindUniformBlock("DrawData", DRAW_DATA_BINDING))
+            pushed = drawBuffer->push(&data, sizeof(data), DRAW_DATA_BINDING);
+
+        if(!pushed)
+        {
+            activeShader->setMat4("model", data.model);
+            activeShader->setVec3("baseColor", glm::vec3(data.baseColor));
+            activeShader->setVec3("highlightColor", glm::vec3(data.highlightColor));
+        }
 
         if(is3D)
         {
-            modelShader->setVec3("cameraPosition", cameraPosition);
+            activeShader->setVec3("cameraPosition", cameraPosition);
             
-            modelShader->setVec3("lightPosition", lightSource.position);
-            // modelShader->setVec4("color", lightSource.color);
-            modelShader->setFloat("lightIntensity", lightSource.intensity);
+            activeShader->setVec3("lightPosition", lightSource.position);
+            // activeShader->setVec4("color", lightSource.color);
+            activeShader->setFloat("lightIntensity", lightSource.intensity);
         }
+        return true;
     }
 
     void setUniform(const std::string uniformName, float uniformValue)
     {
-        modelShader->setFloat(uniformName.c_str(), uniformValue);
+        shader *activeShader = modelShader->getActive();
+        if(activeShader)
+            activeShader->setFloat(uniformName.c_str(), uniformValue);
     }
+};
+
+/* everything needed to draw one model, copied when the frame is recorded so the
+render thread never reads gameObjects the simulation is changing */
+struct renderCommand{
+    model *mesh;
+    drawData data;
+    bool isCircle;
+};
+
+//one recorded frame, filled by the simulation thread and replayed on the thread that owns the GL context
+struct commandBuffer{
+    glm::mat4 viewMatrix = glm::mat4(1.0f);
+    glm::mat4 projectionMatrix = glm::mat4(1.0f);
+    light lightSource = {glm::vec3(0.0f), glm::vec4(0.0f), 0.0f};
+    glm::vec3 cameraPosition = glm::vec3(0.0f);
+    std::vector<renderCommand> commands;
 
-    ~model()
+    void begin(const glm::mat4 &viewMatrix, const glm::mat4 &projectionMatrix, light lightSource, glm::vec3 cameraPosition)
     {
-        glDeleteVertexArrays(1, &VAO);
-        glDeleteBuffers(1, &VBO_position);
-        glDeleteBuffers(1, &EBO);
-        glDeleteBuffers(1, &VBO_normal);
+        this->viewMatrix = viewMatrix;
+        this->projectionMatrix = projectionMatrix;
+        this->lightSource = lightSource;
+        this->cameraPosition = cameraPosition;
+        commands.clear(); // keeps the capacity, so steady state recording does not allocate
+    }
 
-        glDeleteVertexArrays(1, &VAO_Flat);
-        glDeleteBuffers(1, &VBO_FlatPosition);
-        glDeleteBuffers(1, &VBO_FlatShadingNormal);
+    void execute()
+    {
+        for(renderCommand &command : commands)
+        {
+            if(command.mesh->useShader(command.data, viewMatrix, projectionMatrix, lightSource, cameraPosition))
+                command.mesh->draw(command.isCircle);
+        }
     }
 };
 
@@ -1058,6 +1151,19 @@ class gameObject{
     glm::mat4 model; // translation done by user
     bool isCircle; // 0 means block 1 means circle
 
+    boundingBox localBounds; // bounds of the mesh before any transform
+    boundingBox worldBounds; // cached bounds after objTranslation * model
+    glm::mat4 boundsMatrix; // matrix worldBounds was last computed with
+
+    //translate(position) * model, only rebuilt when the position or the model matrix changed
+    glm::mat4 worldMatrix;
+    glm::vec3 worldPosition; // position worldMatrix was built with
+    bool worldDirty = true;
+    std::vector<glm::vec3> worldHull; // convex collider in world space, rewritten by getCollisionShape()
+
+    bodyStorage *bodies; // storage the body lives in, defaultBodies or the one of a physicsWorld
+    bodyHandle body;
+
     public:
     friend class player;
 
@@ -1077,265 +1183,297 @@ class gameObject{
         object.loadModel(filepath.c_str());
         // object.calculateNormals();
         initialize();
+        updateLocalBounds();
     }
 
     void initialize()
     {
         objTranslation = glm::mat4(1.0f);
         model = glm::mat4(1.0f);
+        boundsMatrix = glm::mat4(0.0f);
+
+        bodies = &defaultBodies;
+        body = bodies->create();
+    }
+
+    //owns a body and GL objects, so objects can only be moved
+    gameObject(const gameObject&) = delete;
+    gameObject &operator=(const gameObject&) = delete;
+
+    /* takes over the mesh, its buffers and the body, so objects can be kept by value in a vector. The
+    moved from object has no body left. A physicsWorld keeps pointers, remove an object before moving it */
+    gameObject(gameObject &&other) noexcept
+        : object(std::move(other.object)), physics(std::move(other.physics)), objTranslation(other.objTranslation),
+        model(other.model), isCircle(other.isCircle), localBounds(other.localBounds), worldBounds(other.worldBounds),
+        boundsMatrix(other.boundsMatrix), worldMatrix(other.worldMatrix), worldPosition(other.worldPosition),
+        worldDirty(other.worldDirty), worldHull(std::move(other.worldHull)), bodies(other.bodies), body(other.body)
+    {
+        other.body = NO_BODY;
+    }
+
+    gameObject &operator=(gameObject &&other) noexcept
+    {
+        if(this == &other)
+            return *this;
+
+        if(body != NO_BODY)
+            bodies->destroy(body);
+
+        object = std::move(other.object);
+        physics = std::move(other.physics);
+        objTranslation = other.objTranslation;
+        model = other.model;
+        isCircle = other.isCircle;
+        localBounds = other.localBounds;
+        worldBounds = other.worldBounds;
+        boundsMatrix = other.boundsMatrix;
+        worldMatrix = other.worldMatrix;
+        worldPosition = other.worldPosition;
+        worldDirty = other.worldDirty;
+        worldHull = std::move(other.worldHull);
+        bodies = other.bodies;
+        body = other.body;
+
+        other.body = NO_BODY;
+        return *this;
+    }
+
+    virtual ~gameObject()
+    {
+        if(body != NO_BODY)
+            bodies->destroy(body);
+    }
+
+    //moves the body into another storage, used by physicsWorld when the object is added or removed
+    void moveBody(bodyStorage *storage)
+    {
+        if(storage == bodies)
+            return;
+
+        bodyState state = bodies->getState(body);
+        bodies->destroy(body);
+
+        bodies = storage;
+        body = bodies->create(state);
+    }
+
+    bodyHandle getBody()
+    {
+        return body;
+    }
+
+    bodyStorage *getBodyStorage()
+    {
+        return bodies;
+    }
+
+    //rebuilds objTranslation after the storage integrated the body
+    void updateTransform()
+    {
+        objTranslation = glm::translate(glm::mat4(1.0f), bodies->getPosition(body));
+    }
+
+    //recomputes the mesh bounds, has to be called every time the mesh changes
+    void updateLocalBounds()
+    {
+        std::vector<float> boundary = object.getBoundary();
+
+        localBounds.min = glm::vec3(boundary[0], boundary[2], boundary[4]);
+        localBounds.max = glm::vec3(boundary[1], boundary[3], boundary[5]);
+        boundsMatrix = glm::mat4(0.0f);
     }
 
     void loadModel(std::string filepath)
     {
         object.loadModel(filepath.c_str());
+        updateLocalBounds();
     }
 
     void block2D(float length, float breadth)
     {
         isCircle = false;
+        physics.shape = SHAPE_AABB;
         object.block2D(length, breadth);
         physics.boundary = object.getBoundary();
+        updateLocalBounds();
     }
 
     void block3D(float length, float breadth, float width)
     {
         isCircle = false;
+        physics.shape = SHAPE_AABB;
         object.block3D(length, breadth, width);
         physics.boundary = object.getBoundary();
+        updateLocalBounds();
     }
     
     void sheet3D(float length, float breadth, int subdivisions = 0)
     {
         object.sheet3D(length, breadth, subdivisions);
+        updateLocalBounds();
     }
 
     void terrain(float length, int subdivisions = 0)
     {
         object.terrain(length, subdivisions);
+        updateLocalBounds();
     }
 
     void water(float length, int subdivisions = 0)
     {
         object.water(length, subdivisions);
+        updateLocalBounds();
     }
 
     void grass(float length, int subdivisions = 0)
     {
         object.grass(length, subdivisions);
+        updateLocalBounds();
     }
 
 
     void circle2D(float radius)
     {
         isCircle = true;
+        physics.shape = SHAPE_SPHERE;
         object.circle2D(radius);
         physics.radius = radius;
         physics.boundary = {-radius, radius, -radius, radius, -1, -1};
+        updateLocalBounds();
     }
 
     float applyTransformToFloat(float coordinate, char axis='x')
     {
         if(axis == 'x' || axis == 'X')
-            return glm::vec4(objTranslation * model * glm::vec4(coordinate, 0.0f, 0.0f, 1.0f)).x;
+            return glm::vec4(getWorldMatrix() * glm::vec4(coordinate, 0.0f, 0.0f, 1.0f)).x;
 
         if(axis == 'y' || axis == 'Y')
-            return glm::vec4(objTranslation * model * glm::vec4(0.0f, coordinate, 0.0f, 1.0f)).y;
+            return glm::vec4(getWorldMatrix() * glm::vec4(0.0f, coordinate, 0.0f, 1.0f)).y;
 
         if(axis == 'z' || axis == 'Z')
-            return glm::vec4(objTranslation * model * glm::vec4(0.0f, 0.0f, coordinate, 0.0f)).z;
+            return glm::vec4(getWorldMatrix() * glm::vec4(0.0f, 0.0f, coordinate, 0.0f)).z;
 
         return 0.0f;
     }
 
-    collided checkAABBCollision(gameObject *objPtr)
+    //SHAPE_AABB, SHAPE_SPHERE or SHAPE_OBB, the box ones are made from the mesh bounds
+    void setCollider(int shape)
     {
-        if (!this->getCollisionStatus() || !objPtr->getCollisionStatus())
-        {
-            return {false, 0.0f, glm::vec3(0.0f)};
-        }
-    
-        std::vector<float> objBoundary = objPtr->getBoundary();
-    
-        float thisLeft = applyTransformToFloat(physics.boundary[0], 'X');
-        float thisRight = applyTransformToFloat(physics.boundary[1], 'X');
-        float thisBottom = applyTransformToFloat(physics.boundary[2], 'Y');
-        float thisTop = applyTransformToFloat(physics.boundary[3], 'Y');
-        float thisFar = applyTransformToFloat(physics.boundary[4], 'Z');
-        float thisNear = applyTransformToFloat(physics.boundary[5], 'Z');
-    
-        float otherLeft = objPtr -> applyTransformToFloat(objBoundary[0], 'X');
-        float otherRight = objPtr -> applyTransformToFloat(objBoundary[1], 'X');
-        float otherBottom = objPtr -> applyTransformToFloat(objBoundary[2], 'Y');
-        float otherTop = objPtr -> applyTransformToFloat(objBoundary[3], 'Y');
-        float otherFar = objPtr -> applyTransformToFloat(objBoundary[4], 'Z');
-        float otherNear = objPtr -> applyTransformToFloat(objBoundary[5], 'Z');
-    
-        // AABB overlap test
-        bool collisionOccured = false;
-
-        if(thisFar == thisNear && otherNear == thisNear && otherFar == thisNear)
-            collisionOccured = 
-                (thisLeft < otherRight && thisRight > otherLeft) &&
-                (thisBottom < otherTop && thisTop > otherBottom);
+        physics.shape = shape;
+        wake();
+    }
 
-        else
-            collisionOccured = 
-                (thisLeft < otherRight && thisRight > otherLeft) &&
-                (thisBottom < otherTop && thisTop > otherBottom) &&
-                (thisFar < otherNear && thisNear > otherFar);
+    //segment of halfHeight above and below the center along the local y axis
+    void setCapsuleCollider(float radius, float halfHeight)
+    {
+        physics.shape = SHAPE_CAPSULE;
+        physics.radius = radius;
+        physics.halfHeight = halfHeight;
+        wake();
+    }
 
-    
-        if (!collisionOccured)
-        {
-            // std::cout <<"No Collision\n";
-            return {false, 0.0f, glm::vec3(0.0f)};
-        }
-    
-        std::vector<float> minimums = {
-            otherRight - thisLeft,   // +X
-            thisRight - otherLeft,   // -X
-            otherTop - thisBottom,   // +Y
-            thisTop - otherBottom  // -Y
-            // otherNear - thisFar,     // +Z
-            // thisNear - otherFar      // -Z
-        };
-    
-        float minVal = std::numeric_limits<float>::max();
-        int minIndex = -1;
-        for (int i = 0, s = minimums.size(); i < s; ++i) {
-            if (minimums[i] < 0) continue;
-            if (minimums[i] < minVal) {
-                minVal = minimums[i];
-                minIndex = i;
-            }
-        }
-        glm::vec3 normal(0.0f);
-        // Calculate collision normal based on minimum overlap axis
-        switch (minIndex) {
-            case 0: normal =  glm::vec3(-1, 0, 0); break; // push left
-            case 1: normal =  glm::vec3(1, 0, 0); break;  // push right
-            case 2: normal =  glm::vec3(0, -1, 0); break; // push down
-            case 3: normal =  glm::vec3(0, 1, 0);  break; // push up
-            case 4: normal =  glm::vec3(0, 0, -1); break;// push back
-            case 5: normal =  glm::vec3(0, 0, 1); break;  // push front
-            default: normal =  glm::vec3(0);
-        }
+    //local space points, only their convex hull matters
+    void setConvexCollider(const std::vector<glm::vec3> &points)
+    {
+        physics.shape = SHAPE_CONVEX;
+        physics.hull = points;
+        worldHull.resize(points.size());
+        wake();
+    }
 
-        collided collision = {true, minVal, normal};
-        return collision;
+    int getColliderType()
+    {
+        return physics.shape;
     }
 
-    collided checkSphericalCollision(gameObject *objPtr)
+    //world space collider for the narrowphase, physicsWorld computes it once per step
+    collisionShape getCollisionShape()
     {
-        collided collision = {false, 0.0f, glm::vec3(0.0f)};
-    
-        if (!this->getCollisionStatus() || !objPtr->getCollisionStatus())
+        collisionShape shape;
+        glm::mat4 world = getWorldMatrix();
+
+        shape.box = getWorldBounds();
+        shape.sphere = {glm::vec3(world * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)), physics.radius};
+        shape.type = physics.shape;
+        shape.hasCollision = getCollisionStatus();
+
+        if(physics.shape == SHAPE_OBB)
         {
-            return collision;
-        }
+            //the model matrix may scale, the axes are normalized and the scale moves into the extents
+            shape.obb.center = glm::vec3(world * glm::vec4((localBounds.min + localBounds.max) * 0.5f, 1.0f));
+            glm::vec3 extent = (localBounds.max - localBounds.min) * 0.5f;
 
-        float r1 = physics.radius;
-        float r2 = objPtr->physics.radius;
-    
-        // glm::vec3 c1 = glm::vec3(model * glm::vec4(physics.position, 1.0f));
-        // glm::vec3 c2 = glm::vec3(objPtr->model * glm::vec4(objPtr->physics.position, 1.0f));
+            for(int i = 0; i < 3; i++)
+            {
+                glm::vec3 column = glm::vec3(world[i]);
+                float length = glm::length(column);
 
-        glm::vec4 origin(0.0f, 0.0f, 0.0f, 1.0f);
-        glm::vec3 c1 = glm::vec3(objTranslation * model * origin);
-        glm::vec3 c2 = glm::vec3(objPtr->model * objPtr->objTranslation * origin);
+                if(length > 0.0f)
+                    shape.obb.axes[i] = column / length;
+                shape.obb.halfExtents[i] = extent[i] * length;
+            }
+        }
+        else if(physics.shape == SHAPE_CAPSULE)
+        {
+            shape.capsule.a = glm::vec3(world * glm::vec4(0.0f, -physics.halfHeight, 0.0f, 1.0f));
+            shape.capsule.b = glm::vec3(world * glm::vec4(0.0f, physics.halfHeight, 0.0f, 1.0f));
+            shape.capsule.radius = physics.radius;
 
-        std::cout << "C1:" << c1.x << " " << c1.y << " " << c1.z << " " << "C2:" << c2.x << " " << c2.y << " " << c2.z << "\n";
-    
-        glm::vec3 axis = c2 - c1;
-        float dist = glm::length(axis);
-        std::cout << "length :" << dist <<  "Sum of radii: " << r1+r2<< "\n";
-    
-        if (dist > r1 + r2)
-            return collision; // no collision
-    
-        // Handle zero distance (perfect overlap) to avoid divide-by-zero
-        if (dist != 0.0f)
-            axis = glm::normalize(axis);
-        else
-            axis = glm::vec3(1.0f, 0.0f, 0.0f); // arbitrary axis if centers are exactly the same
-    
-        float penetrationDepth = r1 + r2 - dist;
-        collision = {true, penetrationDepth, axis};
+            glm::vec3 radius(physics.radius);
+            shape.box.min = glm::min(shape.capsule.a, shape.capsule.b) - radius;
+            shape.box.max = glm::max(shape.capsule.a, shape.capsule.b) + radius;
+        }
+        else if(physics.shape == SHAPE_CONVEX && !physics.hull.empty())
+        {
+            shape.box.min = shape.box.max = glm::vec3(world * glm::vec4(physics.hull[0], 1.0f));
+            for(int i = 0, s = physics.hull.size(); i < s; i++)
+            {
+                worldHull[i] = glm::vec3(world * glm::vec4(physics.hull[i], 1.0f));
+                shape.box.min = glm::min(shape.box.min, worldHull[i]);
+                shape.box.max = glm::max(shape.box.max, worldHull[i]);
+            }
+            shape.hull = {worldHull.data(), (int)worldHull.size()};
+        }
 
-        std::cout<<"Collision\n";
-        return collision;
+        return shape;
     }
 
-    collided checkSphereAABBCollision(gameObject *objPtr)
+    //bounds the broadphase uses, capsules and hulls do not have to fit the mesh
+    boundingBox getColliderBounds()
     {
-        //get center of the objects
-        // glm::vec3 c1 = glm::vec3(model * glm::vec4(physics.position, 1.0f));
-        // glm::vec3 c2 = glm::vec3(objPtr->model * glm::vec4(objPtr->physics.position, 1.0f));
+        if(physics.shape == SHAPE_CAPSULE || physics.shape == SHAPE_CONVEX)
+            return getCollisionShape().box;
+        return getWorldBounds();
+    }
 
+    collided checkAABBCollision(gameObject *objPtr)
+    {
         if (!this->getCollisionStatus() || !objPtr->getCollisionStatus())
         {
             return {false, 0.0f, glm::vec3(0.0f)};
         }
 
-        glm::vec4 origin(0.0f, 0.0f, 0.0f, 1.0f);
-        glm::vec3 c1 = glm::vec3(objTranslation * model * origin);
-        glm::vec3 c2 = glm::vec3(objPtr->model * objPtr->objTranslation * origin);
+        return testAABB(getWorldBounds(), objPtr->getWorldBounds());
+    }
 
-        if(this->isCircle)
+    collided checkSphericalCollision(gameObject *objPtr)
+    {
+        if (!this->getCollisionStatus() || !objPtr->getCollisionStatus())
         {
-            std::vector<float> objBoundary = objPtr->getBoundary();
-
-            float otherLeft = objPtr -> applyTransformToFloat(objBoundary[0], 'X');
-            float otherRight = objPtr -> applyTransformToFloat(objBoundary[1], 'X');
-            float otherBottom = objPtr -> applyTransformToFloat(objBoundary[2], 'Y');
-            float otherTop = objPtr -> applyTransformToFloat(objBoundary[3], 'Y');
-            float otherFar = objPtr -> applyTransformToFloat(objBoundary[4], 'Z');
-            float otherNear = objPtr -> applyTransformToFloat(objBoundary[5], 'Z');
-
-            float thisRadius = this->physics.radius;
-            
-            float closestX = std::max(otherLeft, std::min(c1.x, otherRight));
-            float closestY = std::max(otherBottom, std::min(c1.y, otherTop));
-            // float closestZ = std::max(otherFar, std::min(c1.z, otherNear));
-            float closestZ = c1.z;
-
-            glm::vec3 normal = glm::vec3(closestX, closestY, closestZ) - c1;
-
-            if(glm::length(normal) > thisRadius)
-                return {false, 0.0f, glm::vec3(0.0f, 0.0f, 0.0f)};
-
-            std::cout<<"Collision\n";
-            return {true, thisRadius - glm::length(normal), glm::normalize(normal)};
+            return {false, 0.0f, glm::vec3(0.0f)};
         }
-        else
-        {
-            float thisLeft = applyTransformToFloat(physics.boundary[0], 'X');
-            float thisRight = applyTransformToFloat(physics.boundary[1], 'X');
-            float thisBottom = applyTransformToFloat(physics.boundary[2], 'Y');
-            float thisTop = applyTransformToFloat(physics.boundary[3], 'Y');
-            float thisFar = applyTransformToFloat(physics.boundary[4], 'Z');
-            float thisNear = applyTransformToFloat(physics.boundary[5], 'Z');
-
-            float objRadius = objPtr->physics.radius;
-            
-            float closestX = std::max(thisLeft, std::min(c2.x, thisRight));
-            float closestY = std::max(thisBottom, std::min(c2.y, thisTop));
-            // float closestZ = std::max(thisFar, std::min(c2.z, thisNear));
-            float closestZ = c2.z;
 
-            glm::vec3 normal = c2 - glm::vec3(closestX, closestY, closestZ);
-
-            if(glm::length(normal) > objRadius)
-                return {false, 0.0f, glm::vec3(0.0f, 0.0f, 0.0f)};
+        return testSpheres(getCollisionShape().sphere, objPtr->getCollisionShape().sphere);
+    }
 
-            std::cout<<"Collision\n";
-            return {true, objRadius - glm::length(normal), glm::normalize(normal)};
-        }
+    collided checkSphereAABBCollision(gameObject *objPtr)
+    {
+        return testShapes(getCollisionShape(), objPtr->getCollisionShape());
     }
 
     void overlapCorrection(collided collision, gameObject *objPtr)
     {
-        float m1 = this->physics.mass;
+        float m1 = this->getMass();
         float m2 = objPtr->getMass();
 
         float penetrationDepth = collision.overlap;
@@ -1343,38 +1481,33 @@ class gameObject{
         float constant = 0;
         glm::vec3 correction;
 
-        if(this->physics.isStatic){
+        if(this->getStaticStatus()){
             constant = penetrationDepth * percent;
             correction = constant * collision.normal;
-            objPtr->physics.position -= correction;
+            objPtr->setPosition(objPtr->getPosition() - correction);
         } 
-        else if(objPtr -> physics.isStatic){
+        else if(objPtr -> getStaticStatus()){
             constant = penetrationDepth * percent;
             correction = constant * collision.normal;
-            this->physics.position -= correction;
+            this->setPosition(this->getPosition() - correction);
         }
         else
         {
             constant = (penetrationDepth/(m1+m2)) * percent;
             correction = constant * collision.normal;
-            this->physics.position += correction *m2;
-            objPtr->physics.position -= correction *m1;
+            this->setPosition(this->getPosition() + correction *m2);
+            objPtr->setPosition(objPtr->getPosition() - correction *m1);
         }
     }
     
     void collision(gameObject *objPtr)
     {
-        collided coll = {false, 0, glm::vec3(0.0f, 0.0f, 0.0f)};
-
-        if(this->isCircle && objPtr->isCircle)
-            coll = this->checkSphericalCollision(objPtr);
-        else if(!this->isCircle && !objPtr->isCircle)
-            coll = this->checkAABBCollision(objPtr);
-        else
-            coll = this->checkSphereAABBCollision(objPtr);
-        
-        // coll = this->checkSphericalCollision(objPtr);
+        resolveCollision(testShapes(getCollisionShape(), objPtr->getCollisionShape()), objPtr);
+    }
 
+    //positional correction and impulse for a contact found by the narrowphase
+    void resolveCollision(collided coll, gameObject *objPtr)
+    {
         if(coll.hasCollided == false) return;
 
         //positional correction
@@ -1397,23 +1530,23 @@ class gameObject{
 
         float vAlongNormal = glm::dot(vRel, coll.normal);
 
-        if(physics.isStatic)
+        if(getStaticStatus())
         {
             j = -(1 + e) * vAlongNormal * m2;
             impulse = j * coll.normal;
             v1 = u1;
             v2 = u2 - impulse / m2;
 
-            if(abs(v2.y) < 0.1) objPtr->physics.onGround = true;
+            if(abs(v2.y) < 0.1) objPtr->setOnGroundStatus(true);
         }
-        else if(objPtr->physics.isStatic)
+        else if(objPtr->getStaticStatus())
         {
             j = -(1 + e) * vAlongNormal * m1;
             impulse = j * coll.normal;
             v1 = u1 + impulse / m1;
             v2 = u2;
 
-            if(abs(v1.y) < 0.1) physics.onGround = true;
+            if(abs(v1.y) < 0.1) setOnGroundStatus(true);
         }
         else
         {
@@ -1423,34 +1556,34 @@ class gameObject{
             v2 = u2 - impulse / m2;
         }
 
-        this->setVelocity(v1);
-        objPtr->setVelocity(v2);
+        //static bodies are never written, physicsWorld solves contacts sharing one in parallel
+        if(!getStaticStatus())
+            this->setVelocity(v1);
+        if(!objPtr->getStaticStatus())
+            objPtr->setVelocity(v2);
     }
 
-    void updatePhysics(float deltaTime)
+    //game logic that has to run at the fixed step rate, called before the body is integrated
+    virtual void fixedUpdate(float /*deltaTime*/)
     {
-        if(physics.hasGravity && !physics.onGround)
-        {
-            physics.velocity += physics.acceleration * deltaTime;
-        }
-
-        if(physics.onGround)
-        {
-            physics.velocity.y = 0.0f;
-        }
+    }
 
-        physics.position += physics.velocity * deltaTime; 
-        objTranslation = glm::translate(glm::mat4(1.0f), physics.position);
+    //integrates only this body, a physicsWorld integrates all of its bodies in one batch instead
+    void updatePhysics(float deltaTime)
+    {
+        fixedUpdate(deltaTime);
+        bodies->integrateBody(bodies->indexOf(body), deltaTime);
+        updateTransform();
     }
 
     void fall()
     {
-        glm::vec4 temp(physics.position, 1.0f);
+        glm::vec4 temp(getPosition(), 1.0f);
 
         temp = view * model * temp;
 
         if(temp.x < -100)
-            physics.hasGravity = true; 
+            setGravityStatus(true); 
     }
 
     //set functions to set vlaues in the class
@@ -1469,6 +1602,11 @@ class gameObject{
         object.setColor(color);
     }
 
+    void setDrawBuffer(ringBuffer *drawBuffer)
+    {
+        object.setDrawBuffer(drawBuffer);
+    }
+
     // void setHighlightColor(glm::vec4 color)
     // {
     //     object.setColor(color);
@@ -1476,22 +1614,26 @@ class gameObject{
 
     void setMass(float mass)
     {
-        physics.mass = mass;
+        bodies->setMass(body, mass);
     }
     
+    //moving a body from outside the simulation wakes it up
     void setPosition(glm::vec3 position)
     {
-        physics.position = position;
+        bodies->setPosition(body, position);
+        bodies->wake(body);
     }
 
     void setVelocity(glm::vec3 velocity)
     {
-        physics.velocity = velocity;
+        bodies->setVelocity(body, velocity);
+        bodies->wake(body);
     }
 
     void setAcceleration(glm::vec3 acceleration)
     {
-        physics.acceleration += acceleration;
+        bodies->setAcceleration(body, bodies->getAcceleration(body) + acceleration);
+        bodies->wake(body);
     }
 
     void setRestitution(float e)
@@ -1501,22 +1643,46 @@ class gameObject{
 
     void setStatic(bool isStatic)
     {
-        physics.isStatic = isStatic;
+        bodies->setFlag(body, BODY_STATIC, isStatic);
     }
 
     void setGravityStatus(bool status)
     {
-        physics.hasGravity = status;
+        bodies->setFlag(body, BODY_GRAVITY, status);
+        bodies->wake(body);
+    }
+
+    //bullets are swept by physicsWorld every step, costs more but they cannot pass through thin objects
+    void setBullet(bool status)
+    {
+        bodies->setFlag(body, BODY_BULLET, status);
+    }
+
+    bool getBulletStatus()
+    {
+        return bodies->getFlag(body, BODY_BULLET);
+    }
+
+    void wake()
+    {
+        bodies->wake(body);
+    }
+
+    bool getSleepingStatus()
+    {
+        return bodies->getFlag(body, BODY_SLEEPING);
     }
 
     void setModelMatrix(glm::mat4 matrix)
     {
         model = matrix;
+        worldDirty = true;
     }
 
     bool setOnGroundStatus(bool status)
     {
-        return physics.onGround = status;
+        bodies->setFlag(body, BODY_ON_GROUND, status);
+        return status;
     }
 
     //get function to get diff values from the class
@@ -1526,17 +1692,27 @@ class gameObject{
     }
     bool getGravityStatus()
     {
-        return physics.hasGravity;
+        return bodies->getFlag(body, BODY_GRAVITY);
     }
 
     void setCollisionStatus(bool status)
     {
-        physics.hasCollision = status;
+        bodies->setFlag(body, BODY_COLLISION, status);
     }
 
     bool getCollisionStatus()
     {
-        return physics.hasCollision;
+        return bodies->getFlag(body, BODY_COLLISION);
+    }
+
+    float getRestitution()
+    {
+        return physics.coeffOfRestitution;
+    }
+
+    bool getStaticStatus()
+    {
+        return bodies->getFlag(body, BODY_STATIC);
     }
 
     std::vector<float> getBoundary()
@@ -1546,22 +1722,22 @@ class gameObject{
 
     float getMass()
     {
-        return physics.mass;
+        return bodies->getMass(body);
     }
 
     glm::vec3 getPosition()
     {
-        return physics.position;
+        return bodies->getPosition(body);
     }
 
     glm::vec3 getVelocity()
     {
-        return physics.velocity;
+        return bodies->getVelocity(body);
     }
  
     bool getOnGroundStatus()
     {
-        return physics.onGround;
+        return bodies->getFlag(body, BODY_ON_GROUND);
     }
 
     glm::mat4 getTransformationMatrix()
@@ -1569,16 +1745,111 @@ class gameObject{
         return objTranslation;
     }
 
+    glm::mat4 getWorldMatrix()
+    {
+        glm::vec3 position = getPosition();
+        if(worldDirty || position != worldPosition)
+        {
+            worldMatrix = glm::translate(glm::mat4(1.0f), position) * model;
+            worldPosition = position;
+            worldDirty = false;
+        }
+        return worldMatrix;
+    }
+
+    //world matrix between the last two fixed steps, only for drawing
+    glm::mat4 getRenderMatrix()
+    {
+        return glm::translate(glm::mat4(1.0f), bodies->getRenderPosition(body)) * model;
+    }
+
+    boundingBox getLocalBounds()
+    {
+        return localBounds;
+    }
+
+    //matrix set by setModelMatrix(), without the physics translation
+    glm::mat4 getModelMatrix()
+    {
+        return model;
+    }
+
+    //the mesh, for systems that draw the object without going through it (ecs.h)
+    ::model *getMesh()
+    {
+        return &object;
+    }
+
+    bool getCircleStatus()
+    {
+        return isCircle;
+    }
+
+    const std::vector<float> &getVertices()
+    {
+        return object.getVertices();
+    }
+
+    int getGridSize()
+    {
+        return object.getGridSize();
+    }
+
     float getAverageVertices()
     {
         return object.getAverageVertices();
     }
+
+    //world space bounds, only recomputed when the position or model matrix changed
+    boundingBox getWorldBounds()
+    {
+        glm::mat4 world = getWorldMatrix();
+
+        if(world == boundsMatrix)
+            return worldBounds;
+
+        boundsMatrix = world;
+
+        //transform center and extents instead of all 8 corners
+        glm::vec3 center = (localBounds.min + localBounds.max) * 0.5f;
+        glm::vec3 extent = (localBounds.max - localBounds.min) * 0.5f;
+
+        glm::vec3 worldCenter = glm::vec3(world * glm::vec4(center, 1.0f));
+        glm::vec3 worldExtent(0.0f);
+
+        for(int i = 0; i < 3; i++)
+        {
+            worldExtent[i] = std::abs(world[0][i]) * extent.x + std::abs(world[1][i]) * extent.y + std::abs(world[2][i]) * extent.z;
+        }
+
+        worldBounds.min = worldCenter - worldExtent;
+        worldBounds.max = worldCenter + worldExtent;
+        return worldBounds;
+    }
+
+    boundingSphere getBoundingSphere()
+    {
+        boundingBox box = getWorldBounds();
+        glm::vec3 center = (box.min + box.max) * 0.5f;
+
+        return {center, glm::length(box.max - center)};
+    }
+
     //rendering funtions
     void draw(light lightSource, glm::vec3 cameraPos)
     {
-        objTranslation = glm::translate(glm::mat4(1.0f), physics.position);
-        object.useShader(objTranslation * model, lightSource, cameraPos);
-        object.draw(isCircle);
+        if(object.useShader(getRenderMatrix(), lightSource, cameraPos))
+            object.draw(isCircle);
+    }
+
+    //records the draw instead of issuing it, the light and camera come from commandBuffer::begin()
+    void record(commandBuffer &buffer)
+    {
+        renderCommand command;
+        command.mesh = &object;
+        command.data = {getRenderMatrix(), object.getColor(), object.getHighlightColor()};
+        command.isCircle = isCircle;
+        buffer.commands.push_back(command);
     }
 
 };
@@ -1586,6 +1857,7 @@ class gameObject{
 class player : public gameObject {
     private:
     camera playerCam;
+    float jumpBuffer = 0.0f; // time a requested jump stays valid while in the air
     //light?
 
     public:
@@ -1593,16 +1865,17 @@ class player : public gameObject {
     {
         object.setColor(glm::vec4(0.4f,0.4f,0.8f, 1.0f));
 
-        physics.mass = 100.0f;
-        physics.hasGravity = true;
-        physics.acceleration = GRAVITY;
+        setMass(100.0f);
+        setGravityStatus(true);
+        bodies->setAcceleration(body, GRAVITY);
 
-        physics.onGround = false;
-        physics.hasCollision = true;
+        setOnGroundStatus(false);
+        setCollisionStatus(true);
+        setBullet(true);
         physics.coeffOfRestitution = 0.0f;
         // physics.boundary = object.getBoundary();
         
-        glm::vec4 temp(physics.position, 1.0f);
+        glm::vec4 temp(getPosition(), 1.0f);
         temp = temp * model;
 
         playerCam.setCamera(glm::vec3(temp.x, 0.0f, 50.0f), glm::vec3(temp.x, 0.0f, temp.z), glm::vec3(0.0f, 1.0f, 0.0f));
@@ -1614,16 +1887,17 @@ class player : public gameObject {
         object.setShader(modelShader);
         object.setColor(glm::vec4(0.4f,0.4f,0.8f, 1.0f));
 
-        physics.mass = 100.0f;
-        physics.hasGravity = true;
-        physics.acceleration = GRAVITY;
+        setMass(100.0f);
+        setGravityStatus(true);
+        bodies->setAcceleration(body, GRAVITY);
 
-        physics.onGround = false;
-        physics.hasCollision = true;
+        setOnGroundStatus(false);
+        setCollisionStatus(true);
+        setBullet(true);
         physics.coeffOfRestitution = 0.0f;
         // physics.boundary = object.getBoundary();
         
-        glm::vec4 temp(physics.position, 1.0f);
+        glm::vec4 temp(getPosition(), 1.0f);
         temp = temp * model;
 
         playerCam.setCamera(glm::vec3(temp.x, 0.0f, 50.0f), glm::vec3(temp.x, 0.0f, temp.z), glm::vec3(0.0f, 1.0f, 0.0f));
@@ -1635,12 +1909,13 @@ class player : public gameObject {
         object.setShader(modelShader);
         object.setColor(glm::vec4(0.4f,0.4f,0.8f, 1.0f));
 
-        physics.mass = 100.0f;
-        physics.hasGravity = true;
-        physics.acceleration = GRAVITY;
+        setMass(100.0f);
+        setGravityStatus(true);
+        bodies->setAcceleration(body, GRAVITY);
 
-        physics.onGround = false;
-        physics.hasCollision = true;
+        setOnGroundStatus(false);
+        setCollisionStatus(true);
+        setBullet(true);
         physics.coeffOfRestitution = 0.0f;
         // physics.boundary = object.getBoundary();
 
@@ -1648,7 +1923,7 @@ class player : public gameObject {
             block2D(length, breadth);
 
         
-        glm::vec4 temp(physics.position, 1.0f);
+        glm::vec4 temp(getPosition(), 1.0f);
         temp = temp * model;
 
         playerCam.setCamera(glm::vec3(temp.x, 0.0f, 50.0f), glm::vec3(temp.x, 0.0f, temp.z), glm::vec3(0.0f, 1.0f, 0.0f));
@@ -1660,55 +1935,71 @@ class player : public gameObject {
         object.setShader(modelShader);
         object.setColor(glm::vec4(0.4f,0.4f,0.8f, 1.0f));
 
-        physics.mass = 100.0f;
-        physics.hasGravity = true;
-        physics.acceleration = GRAVITY;
+        setMass(100.0f);
+        setGravityStatus(true);
+        bodies->setAcceleration(body, GRAVITY);
 
-        physics.onGround = false;
-        physics.hasCollision = true;
+        setOnGroundStatus(false);
+        setCollisionStatus(true);
+        setBullet(true);
         physics.coeffOfRestitution = 0.0f;
         // physics.boundary = object.getBoundary();
 
         circle2D(radius);
         
-        glm::vec4 temp(physics.position, 1.0f);
+        glm::vec4 temp(getPosition(), 1.0f);
         temp = temp * model;
 
         playerCam.setCamera(glm::vec3(temp.x, 0.0f, 50.0f), glm::vec3(temp.x, 0.0f, temp.z), glm::vec3(0.0f, 1.0f, 0.0f));
 
     }
 
+    //only requests the jump, it is applied in fixedUpdate() so it does not depend on the frame rate
     void jump()
     {
-        if(physics.onGround == true)
+        jumpBuffer = JUMP_BUFFER_TIME;
+    }
+
+    //a jump pressed shortly before landing still happens once the player is on the ground
+    void fixedUpdate(float deltaTime) override
+    {
+        if(jumpBuffer <= 0.0f)
+            return;
+
+        if(getOnGroundStatus() == true)
         {            
-            physics.velocity.y = 85.0f;
+            glm::vec3 velocity = getVelocity();
+            velocity.y = JUMP_SPEED;
+            setVelocity(velocity);
             // physics.acceleration.y = GRAVITY.y - 60.0f;
-            physics.onGround = false;
+            setOnGroundStatus(false);
+            jumpBuffer = 0.0f;
         }
+        else
+            jumpBuffer -= deltaTime;
         // else physics.acceleration.y = GRAVITY.y;
     }
 
     void movements(GLFWwindow* window)
     {
         if(glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-            physics.position += glm::vec3(0.0f, 2.0f, 0.0f);
+            setPosition(getPosition() + glm::vec3(0.0f, 2.0f, 0.0f));
 
         if(glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-            physics.position += glm::vec3(0.0f, -2.0f, 0.0f);
+            setPosition(getPosition() + glm::vec3(0.0f, -2.0f, 0.0f));
 
         if(glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-            physics.position += glm::vec3(2.0f, 0.0f, 0.0f);
+            setPosition(getPosition() + glm::vec3(2.0f, 0.0f, 0.0f));
 
         if(glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-            physics.position += glm::vec3(-2.0f, 0.0f, 0.0f);
+            setPosition(getPosition() + glm::vec3(-2.0f, 0.0f, 0.0f));
     }
 
     //camera stuff
     void updateCamera()
     {
 
-        glm::vec4 temp(physics.position, 1.0f);
+        glm::vec4 temp(getPosition(), 1.0f);
         temp = temp * model;
 
         // playerCam.setCamera(glm::vec3(temp.x, temp.y, 50.0f), glm::vec3(temp.x, temp.y, temp.z), glm::vec3(0.0f, 1.0f, 0.0f));
@@ -1759,11 +2050,11 @@ class obstacle : public gameObject {
     {
         object.setColor(glm::vec4(0.8f,0.8f,0.8f, 1.0f));
         object.setHighlightColor(object.getColor());
-        // physics.hasGravity = true;
-        // physics.acceleration = GRAVITY;
+        // setGravityStatus(true);
+        // bodies->setAcceleration(body, GRAVITY);
 
-        physics.hasCollision = true;
-        physics.isStatic = true;
+        setCollisionStatus(true);
+        setStatic(true);
     }
 
     obstacle(shader* modelShader, float length, float breadth, float width = 0)
@@ -1771,14 +2062,28 @@ class obstacle : public gameObject {
         object.setShader(modelShader);
         object.setColor(glm::vec4(0.8f,0.8f,0.8f, 1.0f));
 
-        physics.hasGravity = true;
-        physics.acceleration = GRAVITY;
+        setGravityStatus(true);
+        bodies->setAcceleration(body, GRAVITY);
 
-        physics.hasCollision = true;
-        // physics.isStatic = true;
+        setCollisionStatus(true);
+        // setStatic(true);
 
         if(width == 0)
             block2D(length, breadth);
+        else
+            block3D(length, breadth, width);
+    }
+
+    obstacle(shader* modelShader, float radius)
+    {
+        object.setShader(modelShader);
+        object.setColor(glm::vec4(0.8f,0.8f,0.8f, 1.0f));
+
+        setGravityStatus(true);
+        bodies->setAcceleration(body, GRAVITY);
+
+        setCollisionStatus(true);
+        circle2D(radius);
     }
 };
 
@@ -1789,11 +2094,11 @@ class ground : public gameObject {
         object.setColor(glm::vec4(0.3f, 0.3f, 0.3f, 1.0f));
         object.setHighlightColor(glm::vec4(0.8f, 0.3f, 0.3f, 1.0f));
 
-        physics.mass = 500;
-        physics.acceleration = GRAVITY;
+        setMass(500);
+        bodies->setAcceleration(body, GRAVITY);
 
-        physics.hasCollision = true;
-        physics.isStatic = true;
+        setCollisionStatus(true);
+        setStatic(true);
     }
 
     ground(shader* modelShader)
@@ -1801,11 +2106,11 @@ class ground : public gameObject {
         object.setShader(modelShader);
         object.setColor(glm::vec4(0.2f,0.8f,0.2f, 1.0f));
 
-        physics.mass = 500;
-        physics.acceleration = GRAVITY;
+        setMass(500);
+        bodies->setAcceleration(body, GRAVITY);
 
-        physics.hasCollision = true;
-        physics.isStatic = true;
+        setCollisionStatus(true);
+        setStatic(true);
     }
 
     ground(shader* modelShader, float length, float breadth, float width = 0)
@@ -1813,11 +2118,11 @@ class ground : public gameObject {
         object.setShader(modelShader);
         object.setColor(glm::vec4(0.2f,0.8f,0.2f, 1.0f));
 
-        physics.mass = 500;
-        physics.acceleration = GRAVITY;
+        setMass(500);
+        bodies->setAcceleration(body, GRAVITY);
 
-        physics.hasCollision = true;
-        physics.isStatic = true;
+        setCollisionStatus(true);
+        setStatic(true);
 
         if(width == 0)
             block2D(length, breadth);
@@ -1828,13 +2133,15 @@ class ground : public gameObject {
         object.setShader(modelShader);
         object.setColor(glm::vec4(0.2f,0.8f,0.2f, 1.0f));
 
-        physics.mass = 500;
-        physics.acceleration = GRAVITY;
+        setMass(500);
+        bodies->setAcceleration(body, GRAVITY);
 
-        physics.hasCollision = true;
-        physics.isStatic = true;
+        setCollisionStatus(true);
+        setStatic(true);
         // physics.boundary = object.getBoundary();
 
         circle2D(radius);
     }
-};
\ No newline at end of file
+};
+
+#endif
@@ -0,0 +1,142 @@
+#ifndef GLRESOURCE_H
+#define GLRESOURCE_H
+
+#include <glad/glad.h>
+
+/* owner of one GL object name. It deletes the object when it goes out of scope and can only be moved, so a
+class holding these can not copy a name and delete it twice, and its own move constructor is correct by
+default. The traits say how the object type is created and deleted */
+template<typename TRAITS>
+class glHandle{
+    private:
+    unsigned int id = 0;
+
+    public:
+    glHandle()
+    {
+    }
+
+    //takes ownership of a name made elsewhere, e.g. by glCreateProgram
+    explicit glHandle(unsigned int name)
+    {
+        id = name;
+    }
+
+    glHandle(const glHandle&) = delete;
+    glHandle &operator=(const glHandle&) = delete;
+
+    glHandle(glHandle &&other) noexcept
+    {
+        id = other.id;
+        other.id = 0;
+    }
+
+    glHandle &operator=(glHandle &&other) noexcept
+    {
+        if(this != &other)
+        {
+            reset();
+            id = other.id;
+            other.id = 0;
+        }
+        return *this;
+    }
+
+    ~glHandle()
+    {
+        reset();
+    }
+
+    //deletes the current object and makes a new one
+    void create()
+    {
+        reset();
+        id = TRAITS::create();
+    }
+
+    //deletes the current object and owns name instead, 0 leaves the handle empty
+    void reset(unsigned int name = 0)
+    {
+        if(id != 0)
+            TRAITS::destroy(id);
+        id = name;
+    }
+
+    //gives up ownership without deleting, the caller deletes the name
+    unsigned int release()
+    {
+        unsigned int name = id;
+        id = 0;
+        return name;
+    }
+
+    unsigned int get() const
+    {
+        return id;
+    }
+
+    bool valid() const
+    {
+        return id != 0;
+    }
+};
+
+struct glBufferTraits{
+    static unsigned int create()
+    {
+        unsigned int id = 0;
+        glGenBuffers(1, &id);
+        return id;
+    }
+
+    static void destroy(unsigned int id)
+    {
+        glDeleteBuffers(1, &id);
+    }
+};
+
+struct glVertexArrayTraits{
+    static unsigned int create()
+    {
+        unsigned int id = 0;
+        glGenVertexArrays(1, &id);
+        return id;
+    }
+
+    static void destroy(unsigned int id)
+    {
+        glDeleteVertexArrays(1, &id);
+    }
+};
+
+struct glProgramTraits{
+    static unsigned int create()
+    {
+        return glCreateProgram();
+    }
+
+    static void destroy(unsigned int id)
+    {
+        glDeleteProgram(id);
+    }
+};
+
+//shader stages are made with a type, so they are only ever adopted with reset(glCreateShader(type))
+struct glShaderStageTraits{
+    static unsigned int create()
+    {
+        return 0;
+    }
+
+    static void destroy(unsigned int id)
+    {
+        glDeleteShader(id);
+    }
+};
+
+typedef glHandle<glBufferTraits> glBuffer;
+typedef glHandle<glVertexArrayTraits> glVertexArray;
+typedef glHandle<glProgramTraits> glProgram;
+typedef glHandle<glShaderStageTraits> glShaderStage;
+
+#endif
@@ -0,0 +1,391 @@
+#ifndef HIERARCHY_H
+#define HIERARCHY_H
+
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+//stable id of a node inside a transformHierarchy, the index behind it changes when the tree is reordered
+typedef int transformHandle;
+const transformHandle NO_TRANSFORM = -1;
+
+/* parent/child transforms with local translation, rotation and scale. The nodes are stored as arrays in
+breadth first order, so every parent comes before its children and update() builds all world matrices in
+one pass from front to back. Changing a node only marks it dirty, update() starts at the first dirty node
+and only rebuilds the matrices under a change, the rest of the pass just reads the flags */
+class transformHierarchy{
+    public:
+    std::vector<glm::vec3> position;
+    std::vector<glm::quat> rotation;
+    std::vector<glm::vec3> scale;
+    std::vector<glm::mat4> world;
+    std::vector<int> parent; // index of the parent, -1 for roots
+    std::vector<char> dirty; // local transform changed since the last update
+    std::vector<transformHandle> owner; // handle of the node stored at each index
+
+    private:
+    std::vector<int> handleIndex; // handle -> index, -1 for free handles
+    std::vector<transformHandle> freeHandles;
+
+    //tree links by handle, only walked when the order is rebuilt
+    std::vector<transformHandle> parentHandle, firstChild, nextSibling;
+
+    int firstDirty = 0; // nothing before this index has to be rebuilt
+    bool orderDirty = false; // nodes were added, removed or moved to another parent
+    int updatedCount = 0;
+
+    std::vector<int> order; // scratch for reorder()
+    std::vector<char> changed;
+
+    void markDirty(int index)
+    {
+        dirty[index] = 1;
+        firstDirty = std::min(firstDirty, index);
+    }
+
+    void link(transformHandle handle, transformHandle parentNode)
+    {
+        parentHandle[handle] = parentNode;
+        nextSibling[handle] = NO_TRANSFORM;
+        if(parentNode == NO_TRANSFORM)
+            return;
+
+        nextSibling[handle] = firstChild[parentNode];
+        firstChild[parentNode] = handle;
+    }
+
+    void unlink(transformHandle handle)
+    {
+        transformHandle parentNode = parentHandle[handle];
+        if(parentNode == NO_TRANSFORM)
+            return;
+
+        transformHandle *slot = &firstChild[parentNode];
+        while(*slot != handle)
+            slot = &nextSibling[*slot];
+        *slot = nextSibling[handle];
+        parentHandle[handle] = NO_TRANSFORM;
+    }
+
+    template<typename T>
+    void permute(std::vector<T> &array)
+    {
+        std::vector<T> sorted(array.size());
+        for(int i = 0, s = order.size(); i < s; i++)
+            sorted[i] = array[order[i]];
+        array.swap(sorted);
+    }
+
+    //puts the nodes back into breadth first order, roots first in their current order
+    void reorder()
+    {
+        int size = owner.size();
+        order.clear();
+
+        for(int i = 0; i < size; i++)
+        {
+            if(parentHandle[owner[i]] == NO_TRANSFORM)
+                order.push_back(i);
+        }
+
+        for(int i = 0; i < (int)order.size(); i++)
+        {
+            for(transformHandle child = firstChild[owner[order[i]]]; child != NO_TRANSFORM; child = nextSibling[child])
+                order.push_back(handleIndex[child]);
+        }
+
+        permute(position);
+        permute(rotation);
+        permute(scale);
+        permute(world);
+        permute(dirty);
+        permute(owner);
+
+        for(int i = 0; i < size; i++)
+            handleIndex[owner[i]] = i;
+
+        parent.resize(size);
+        for(int i = 0; i < size; i++)
+        {
+            transformHandle parentNode = parentHandle[owner[i]];
+            parent[i] = parentNode == NO_TRANSFORM ? -1 : handleIndex[parentNode];
+        }
+
+        //a node may now sit in front of the old first dirty one
+        firstDirty = size;
+        for(int i = 0; i < size; i++)
+        {
+            if(dirty[i])
+            {
+                firstDirty = i;
+                break;
+            }
+        }
+        orderDirty = false;
+    }
+
+    public:
+    transformHandle create(transformHandle parentNode = NO_TRANSFORM)
+    {
+        transformHandle handle;
+        if(!freeHandles.empty())
+        {
+            handle = freeHandles.back();
+            freeHandles.pop_back();
+        }
+        else
+        {
+            handle = handleIndex.size();
+            handleIndex.push_back(-1);
+            parentHandle.push_back(NO_TRANSFORM);
+            firstChild.push_back(NO_TRANSFORM);
+            nextSibling.push_back(NO_TRANSFORM);
+        }
+
+        int index = owner.size();
+        position.push_back(glm::vec3(0.0f));
+        rotation.push_back(glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+        scale.push_back(glm::vec3(1.0f));
+        world.push_back(glm::mat4(1.0f));
+        parent.push_back(parentNode == NO_TRANSFORM ? -1 : handleIndex[parentNode]);
+        dirty.push_back(0);
+        owner.push_back(handle);
+        handleIndex[handle] = index;
+
+        firstChild[handle] = NO_TRANSFORM;
+        link(handle, parentNode);
+        markDirty(index);
+
+        //appended children still come after their parent, they only go back to breadth first order for the cache
+        orderDirty = orderDirty || parentNode != NO_TRANSFORM;
+        return handle;
+    }
+
+    //the children become roots and keep their local transform
+    void destroy(transformHandle handle)
+    {
+        while(firstChild[handle] != NO_TRANSFORM)
+            setParent(firstChild[handle], NO_TRANSFORM);
+        unlink(handle);
+
+        //the last node moves into the hole, the order is rebuilt on the next update
+        int index = handleIndex[handle];
+        int last = owner.size() - 1;
+        if(index != last)
+        {
+            position[index] = position[last];
+            rotation[index] = rotation[last];
+            scale[index] = scale[last];
+            world[index] = world[last];
+            dirty[index] = 1;
+            owner[index] = owner[last];
+            handleIndex[owner[index]] = index;
+        }
+
+        position.pop_back();
+        rotation.pop_back();
+        scale.pop_back();
+        world.pop_back();
+        parent.pop_back();
+        dirty.pop_back();
+        owner.pop_back();
+
+        handleIndex[handle] = -1;
+        freeHandles.push_back(handle);
+        orderDirty = true;
+    }
+
+    //keeps the local transform, so the node moves with its new parent
+    void setParent(transformHandle handle, transformHandle parentNode)
+    {
+        if(parentHandle[handle] == parentNode)
+            return;
+
+        //a node can not go under its own subtree
+        for(transformHandle up = parentNode; up != NO_TRANSFORM; up = parentHandle[up])
+        {
+            if(up == handle)
+                return;
+        }
+
+        unlink(handle);
+        link(handle, parentNode);
+        markDirty(handleIndex[handle]);
+        orderDirty = true;
+    }
+
+    transformHandle getParent(transformHandle handle)
+    {
+        return parentHandle[handle];
+    }
+
+    //calls function(child) for the direct children
+    template<typename F>
+    void forEachChild(transformHandle handle, F function)
+    {
+        for(transformHandle child = firstChild[handle]; child != NO_TRANSFORM; child = nextSibling[child])
+            function(child);
+    }
+
+    int indexOf(transformHandle handle) const
+    {
+        return handleIndex[handle];
+    }
+
+    void setPosition(transformHandle handle, glm::vec3 value)
+    {
+        int index = handleIndex[handle];
+        position[index] = value;
+        markDirty(index);
+    }
+
+    void setRotation(transformHandle handle, glm::quat value)
+    {
+        int index = handleIndex[handle];
+        rotation[index] = value;
+        markDirty(index);
+    }
+
+    void setScale(transformHandle handle, glm::vec3 value)
+    {
+        int index = handleIndex[handle];
+        scale[index] = value;
+        markDirty(index);
+    }
+
+    glm::vec3 getPosition(transformHandle handle) const
+    {
+        return position[handleIndex[handle]];
+    }
+
+    glm::quat getRotation(transformHandle handle) const
+    {
+        return rotation[handleIndex[handle]];
+    }
+
+    glm::vec3 getScale(transformHandle handle) const
+    {
+        return scale[handleIndex[handle]];
+    }
+
+    //world matrix of the last update()
+    const glm::mat4 &getWorldMatrix(transformHandle handle) const
+    {
+        return world[handleIndex[handle]];
+    }
+
+    glm::vec3 getWorldPosition(transformHandle handle) const
+    {
+        return glm::vec3(world[handleIndex[handle]][3]);
+    }
+
+    //translation * rotation * scale of the node
+    glm::mat4 getLocalMatrix(int index) const
+    {
+        glm::mat4 local = glm::mat4_cast(rotation[index]);
+        local[0] *= scale[index].x;
+        local[1] *= scale[index].y;
+        local[2] *= scale[index].z;
+        local[3] = glm::vec4(position[index], 1.0f);
+        return local;
+    }
+
+    /* rebuilds the world matrices of the dirty nodes and everything under them, once per frame before
+    anything reads them. A node changed when it is dirty itself or its parent changed, and since parents
+    come first that is known by the time the node is reached */
+    void update()
+    {
+        if(orderDirty)
+            reorder();
+
+        int size = owner.size();
+        changed.assign(size, 0);
+        updatedCount = 0;
+
+        for(int i = firstDirty; i < size; i++)
+        {
+            int up = parent[i];
+            if(!dirty[i] && (up < 0 || !changed[up]))
+                continue;
+
+            world[i] = up < 0 ? getLocalMatrix(i) : world[up] * getLocalMatrix(i);
+            dirty[i] = 0;
+            changed[i] = 1;
+            updatedCount++;
+        }
+
+        firstDirty = size;
+    }
+
+    //world matrices the last update() rebuilt
+    int getUpdatedCount()
+    {
+        return updatedCount;
+    }
+
+    int size()
+    {
+        return owner.size();
+    }
+};
+
+struct hierarchyBenchmarkResult{
+    double fullTime = 0.0; // milliseconds to rebuild every world matrix
+    double dirtyTime = 0.0; // milliseconds for update() with the changed fraction of roots moved
+    int updated = 0; // matrices the dirty update rebuilt
+};
+
+/* a forest of count nodes, roots with a few levels of children under each, where changedFraction of the
+roots move every frame. Compares update() against rebuilding every matrix */
+inline hierarchyBenchmarkResult benchmarkHierarchy(int count = 20000, float changedFraction = 0.05f, int passes = 50)
+{
+    transformHierarchy tree;
+    std::vector<transformHandle> roots;
+
+    srand(1);
+    for(int i = 0; i < count; i++)
+    {
+        //every 8th node starts a new tree, the others go under a random node of the current one
+        transformHandle parentNode = NO_TRANSFORM;
+        if(i % 8 != 0)
+            parentNode = roots.back() + rand() % (i % 8);
+
+        transformHandle node = tree.create(parentNode);
+        tree.setPosition(node, glm::vec3(rand() % 100, rand() % 100, 0.0f));
+        if(parentNode == NO_TRANSFORM)
+            roots.push_back(node);
+    }
+    tree.update();
+
+    int moved = std::max(1, (int)(roots.size() * changedFraction));
+    hierarchyBenchmarkResult result;
+
+    auto start = std::chrono::steady_clock::now();
+    for(int pass = 0; pass < passes; pass++)
+    {
+        for(int i = 0, s = tree.size(); i < s; i++)
+            tree.world[i] = tree.parent[i] < 0 ? tree.getLocalMatrix(i) : tree.world[tree.parent[i]] * tree.getLocalMatrix(i);
+    }
+    auto middle = std::chrono::steady_clock::now();
+    for(int pass = 0; pass < passes; pass++)
+    {
+        for(int i = 0; i < moved; i++)
+        {
+            transformHandle root = roots[(pass * moved + i) % roots.size()];
+            tree.setPosition(root, tree.getPosition(root) + glm::vec3(1.0f, 0.0f, 0.0f));
+        }
+        tree.update();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    result.fullTime = std::chrono::duration<double, std::milli>(middle - start).count() / passes;
+    result.dirtyTime = std::chrono::duration<double, std::milli>(end - middle).count() / passes;
+    result.updated = tree.getUpdatedCount();
+    return result;
+}
+
+#endif
@@ -0,0 +1,438 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+
+typedef std::function<void()> job;
+
+/* counts the unfinished jobs of a group. Waiting on it helps with other jobs instead of blocking, and jobs
+can be held back until it reaches zero, which is how dependencies are expressed:
+
+    jobCounter heights, normals;
+    jobs.parallelFor(rows, 16, [&](int first, int last){ ... }, &heights);
+    jobs.run([&]{ ... }, &normals, &heights); // starts once all height jobs are done
+    jobs.wait(normals);
+*/
+class jobCounter{
+    private:
+    friend class jobSystem;
+
+    std::atomic<int> count{0};
+    std::mutex mutex; // guards dependents against the last job finishing while one is added
+    std::vector<std::pair<job, jobCounter*>> dependents;
+
+    public:
+    jobCounter() = default;
+    jobCounter(const jobCounter&) = delete;
+    jobCounter &operator=(const jobCounter&) = delete;
+
+    bool done() const
+    {
+        return count.load(std::memory_order_acquire) == 0;
+    }
+};
+
+/* work stealing scheduler. Every worker owns a deque, it pushes and pops its own jobs at the back and, when
+it runs dry, steals from the front of the others, so big ranges split up where there is idle time. Jobs
+started from outside the workers are spread over the deques. GL calls only work on the thread that owns the
+context, runOnMainThread() queues them for runMainThreadJobs() which the main loop calls every frame */
+class jobSystem{
+    private:
+    typedef std::pair<job, jobCounter*> jobEntry;
+
+    //deque as a ring that only grows, so a steady frame does not allocate
+    struct workerQueue{
+        std::mutex mutex;
+        std::vector<jobEntry> ring; // capacity is a power of two
+        size_t head = 0;
+        size_t count = 0;
+
+        void pushBack(jobEntry entry)
+        {
+            if(count == ring.size())
+            {
+                std::vector<jobEntry> grown(std::max<size_t>(64, ring.size() * 2));
+                for(size_t i = 0; i < count; i++)
+                    grown[i] = std::move(ring[(head + i) & (ring.size() - 1)]);
+                ring.swap(grown);
+                head = 0;
+            }
+            ring[(head + count) & (ring.size() - 1)] = std::move(entry);
+            count++;
+        }
+
+        jobEntry popBack()
+        {
+            count--;
+            return std::move(ring[(head + count) & (ring.size() - 1)]);
+        }
+
+        jobEntry popFront()
+        {
+            jobEntry entry = std::move(ring[head]);
+            head = (head + 1) & (ring.size() - 1);
+            count--;
+            return entry;
+        }
+    };
+
+    std::vector<std::unique_ptr<workerQueue>> queues; // one per worker
+    std::vector<std::thread> workers;
+
+    workerQueue mainQueue;
+    std::thread::id mainThread;
+
+    std::mutex sleepMutex;
+    std::condition_variable wakeUp;
+    std::atomic<int> queued{0};
+    std::atomic<unsigned int> nextQueue{0};
+    bool stopping = false;
+
+    //index of the worker running on this thread, -1 on other threads
+    static int &workerIndex()
+    {
+        static thread_local int index = -1;
+        return index;
+    }
+
+    static jobSystem *&workerOwner()
+    {
+        static thread_local jobSystem *owner = NULL;
+        return owner;
+    }
+
+    int ownQueue()
+    {
+        return workerOwner() == this ? workerIndex() : -1;
+    }
+
+    void push(workerQueue &queue, job function, jobCounter *counter)
+    {
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.pushBack(jobEntry(std::move(function), counter));
+        }
+
+        if(&queue != &mainQueue)
+        {
+            queued.fetch_add(1, std::memory_order_release);
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            wakeUp.notify_one();
+        }
+    }
+
+    void enqueue(job function, jobCounter *counter)
+    {
+        int own = ownQueue();
+        if(own < 0)
+            own = nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+        push(*queues[own], std::move(function), counter);
+    }
+
+    //own deque from the back first, then the front of the others
+    bool take(int own, jobEntry &out)
+    {
+        int count = queues.size();
+        int start = own >= 0 ? own : 0;
+
+        for(int i = 0; i < count; i++)
+        {
+            int index = (start + i) % count;
+            workerQueue &queue = *queues[index];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if(queue.count == 0)
+                continue;
+
+            out = index == own ? queue.popBack() : queue.popFront();
+            queued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    bool takeMain(jobEntry &out)
+    {
+        std::lock_guard<std::mutex> lock(mainQueue.mutex);
+        if(mainQueue.count == 0)
+            return false;
+
+        out = mainQueue.popFront();
+        return true;
+    }
+
+    //runs the job and releases what waited on its counter
+    void execute(jobEntry &entry)
+    {
+        entry.first();
+        entry.first = nullptr;
+
+        jobCounter *counter = entry.second;
+        if(counter == NULL)
+            return;
+
+        /* the count drops under the lock, and wait() takes the lock once before it returns, so a counter on the
+        stack of the waiting thread is never touched after it was destroyed */
+        std::vector<jobEntry> released;
+        {
+            std::lock_guard<std::mutex> lock(counter->mutex);
+            if(counter->count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                released.swap(counter->dependents);
+        }
+
+        for(auto &dependent : released)
+            enqueue(std::move(dependent.first), dependent.second);
+    }
+
+    void workerLoop(int index)
+    {
+        workerIndex() = index;
+        workerOwner() = this;
+
+        jobEntry entry;
+        while(true)
+        {
+            if(take(index, entry))
+            {
+                execute(entry);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wakeUp.wait(lock, [this]{ return stopping || queued.load(std::memory_order_acquire) > 0; });
+            if(stopping && queued.load() == 0)
+                return;
+        }
+    }
+
+    public:
+    //0 starts one worker per core but one, the thread that creates the system counts as a worker in wait()
+    jobSystem(int workerCount = 0)
+    {
+        if(workerCount <= 0)
+            workerCount = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+
+        mainThread = std::this_thread::get_id();
+        for(int i = 0; i < workerCount; i++)
+            queues.emplace_back(new workerQueue());
+        for(int i = 0; i < workerCount; i++)
+            workers.emplace_back(&jobSystem::workerLoop, this, i);
+    }
+
+    jobSystem(const jobSystem&) = delete;
+    jobSystem &operator=(const jobSystem&) = delete;
+
+    ~jobSystem()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wakeUp.notify_all();
+
+        for(std::thread &t : workers)
+            t.join();
+    }
+
+    int getWorkerCount()
+    {
+        return workers.size();
+    }
+
+    //threads that take part in a parallelFor, the workers and the waiting thread
+    int getThreadCount()
+    {
+        return workers.size() + 1;
+    }
+
+    /* starts the job, counter (if any) counts it until it finished. With dependency the job is held back
+    until that counter reaches zero */
+    void run(job function, jobCounter *counter = NULL, jobCounter *dependency = NULL)
+    {
+        if(counter != NULL)
+            counter->count.fetch_add(1, std::memory_order_relaxed);
+
+        if(dependency != NULL)
+        {
+            std::lock_guard<std::mutex> lock(dependency->mutex);
+            if(dependency->count.load(std::memory_order_acquire) != 0)
+            {
+                dependency->dependents.emplace_back(std::move(function), counter);
+                return;
+            }
+        }
+
+        enqueue(std::move(function), counter);
+    }
+
+    //the job only runs inside runMainThreadJobs() or a wait() on the main thread, for GL calls
+    void runOnMainThread(job function, jobCounter *counter = NULL)
+    {
+        if(counter != NULL)
+            counter->count.fetch_add(1, std::memory_order_relaxed);
+        push(mainQueue, std::move(function), counter);
+    }
+
+    //runs the queued main thread jobs, returns how many
+    int runMainThreadJobs()
+    {
+        if(std::this_thread::get_id() != mainThread)
+            return 0;
+
+        int count = 0;
+        jobEntry entry;
+        while(takeMain(entry))
+        {
+            execute(entry);
+            count++;
+        }
+        return count;
+    }
+
+    //helps with other jobs until the counter reaches zero, so waiting inside a job does not block a worker
+    void wait(jobCounter &counter)
+    {
+        bool onMain = std::this_thread::get_id() == mainThread;
+        int own = ownQueue();
+
+        jobEntry entry;
+        while(!counter.done())
+        {
+            if((onMain && takeMain(entry)) || take(own, entry))
+                execute(entry);
+            else
+                std::this_thread::yield();
+        }
+
+        //the job that finished last may still hold the lock
+        std::lock_guard<std::mutex> lock(counter.mutex);
+    }
+
+    /* calls work(chunk, first, last) for at most maxChunks slices of [0, count) with at least minPerChunk
+    items each and waits for them. The calling thread does the first slice. Chunks are numbered in range
+    order, so per chunk output merged by chunk index does not depend on the thread count. Returns the
+    number of chunks */
+    template<typename F>
+    int parallelRanges(int count, int minPerChunk, int maxChunks, F work)
+    {
+        int chunks = std::max(1, std::min(maxChunks, count / std::max(1, minPerChunk)));
+        int perChunk = (count + chunks - 1) / chunks;
+
+        //the jobs only capture the context and their chunk, small enough for std::function to keep them inline
+        struct rangeContext{
+            F *work;
+            int count, perChunk;
+        } context = {&work, count, perChunk};
+        rangeContext *shared = &context;
+
+        jobCounter counter;
+        for(int i = 1; i < chunks; i++)
+        {
+            run([shared, i]{
+                (*shared->work)(i, std::min(shared->count, i * shared->perChunk), std::min(shared->count, (i + 1) * shared->perChunk));
+            }, &counter);
+        }
+
+        work(0, 0, std::min(count, perChunk));
+        wait(counter);
+        return chunks;
+    }
+
+    //work(first, last) over [0, count) split for all threads, without waiting when counter is given
+    template<typename F>
+    void parallelFor(int count, int minPerJob, F work, jobCounter *counter = NULL)
+    {
+        if(counter == NULL)
+        {
+            parallelRanges(count, minPerJob, getThreadCount() * 4, [&work](int, int first, int last){ work(first, last); });
+            return;
+        }
+
+        int chunks = std::max(1, std::min(getThreadCount() * 4, count / std::max(1, minPerJob)));
+        int perChunk = (count + chunks - 1) / chunks;
+        for(int i = 0; i < chunks; i++)
+        {
+            int first = std::min(count, i * perChunk);
+            int last = std::min(count, (i + 1) * perChunk);
+            run([work, first, last]{ work(first, last); }, counter);
+        }
+    }
+};
+
+//scheduler shared by the engine subsystems, started on first use from the main thread
+inline jobSystem &engineJobs()
+{
+    static jobSystem system;
+    return system;
+}
+
+struct jobBenchmarkResult{
+    double jobTime = 0.0; // microseconds to run and wait for one empty job
+    double batchTime = 0.0; // nanoseconds per job when many empty jobs are started at once
+    double parallelForTime = 0.0; // microseconds for a parallelRanges over all threads with no work
+    double threadTime = 0.0; // microseconds for the same split with a std::thread per slice, as before
+};
+
+//overhead of the scheduler itself, every job is empty
+inline jobBenchmarkResult benchmarkJobs(int jobCount = 100000, int rounds = 1000)
+{
+    jobSystem &jobs = engineJobs();
+    jobBenchmarkResult result;
+    std::atomic<int> sink{0};
+
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < rounds; i++)
+    {
+        jobCounter counter;
+        jobs.run([&sink]{ sink.fetch_add(1, std::memory_order_relaxed); }, &counter);
+        jobs.wait(counter);
+    }
+    auto end = std::chrono::steady_clock::now();
+    result.jobTime = std::chrono::duration<double, std::micro>(end - start).count() / rounds;
+
+    start = std::chrono::steady_clock::now();
+    {
+        jobCounter counter;
+        for(int i = 0; i < jobCount; i++)
+            jobs.run([&sink]{ sink.fetch_add(1, std::memory_order_relaxed); }, &counter);
+        jobs.wait(counter);
+    }
+    end = std::chrono::steady_clock::now();
+    result.batchTime = std::chrono::duration<double, std::nano>(end - start).count() / jobCount;
+
+    int threads = jobs.getThreadCount();
+    start = std::chrono::steady_clock::now();
+    for(int i = 0; i < rounds; i++)
+    {
+        jobs.parallelRanges(threads, 1, threads, [&sink](int, int first, int last){
+            sink.fetch_add(last - first, std::memory_order_relaxed);
+        });
+    }
+    end = std::chrono::steady_clock::now();
+    result.parallelForTime = std::chrono::duration<double, std::micro>(end - start).count() / rounds;
+
+    int threadRounds = std::max(1, rounds / 10);
+    start = std::chrono::steady_clock::now();
+    for(int i = 0; i < threadRounds; i++)
+    {
+        std::vector<std::thread> spawned;
+        for(int t = 1; t < threads; t++)
+            spawned.emplace_back([&sink]{ sink.fetch_add(1, std::memory_order_relaxed); });
+        sink.fetch_add(1, std::memory_order_relaxed);
+        for(std::thread &t : spawned)
+            t.join();
+    }
+    end = std::chrono::steady_clock::now();
+    result.threadTime = std::chrono::duration<double, std::micro>(end - start).count() / threadRounds;
+
+    return result;
+}
+
+#endif
@@ -0,0 +1,307 @@
+#ifndef LIGHTING_H
+#define LIGHTING_H
+
+#include <glad/glad.h>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <cmath>
+
+#include <glm/glm.hpp>
+
+#include "shader.h"
+#include "jobs.h"
+
+//shader storage binding points used by the clustered lighting buffers
+const unsigned int POINT_LIGHT_BINDING = 2;
+const unsigned int CLUSTER_BINDING = 3;
+const unsigned int LIGHT_INDEX_BINDING = 4;
+
+//point light as stored in the light buffer (std430, 32 bytes)
+struct pointLight{
+    glm::vec3 position;
+    float radius; // no influence past this distance
+    glm::vec3 color;
+    float intensity;
+};
+
+/* GLSL side of the clustered lighting, meant to be pasted into fragment shaders. The caller passes the
+world space position and normal plus the view space depth (-(view * worldPosition).z) of the fragment */
+const char* const clusteredLightingGLSL = R"(
+struct PointLight { vec3 position; float radius; vec3 color; float intensity; };
+layout(std430, binding = 2) readonly buffer PointLights { PointLight pointLights[]; };
+layout(std430, binding = 3) readonly buffer Clusters { uvec2 clusters[]; }; // offset, count
+layout(std430, binding = 4) readonly buffer LightIndices { uint lightIndices[]; };
+
+uniform uvec3 clusterCounts;
+uniform vec2 clusterNearFar;
+uniform vec2 screenSize;
+
+uint clusterIndex(vec2 fragCoord, float viewDepth)
+{
+    float slice = log(viewDepth / clusterNearFar.x) / log(clusterNearFar.y / clusterNearFar.x);
+    uint z = uint(clamp(slice * float(clusterCounts.z), 0.0, float(clusterCounts.z - 1u)));
+    uvec2 tile = uvec2(clamp(fragCoord / screenSize * vec2(clusterCounts.xy), vec2(0.0), vec2(clusterCounts.xy) - 1.0));
+    return (z * clusterCounts.y + tile.y) * clusterCounts.x + tile.x;
+}
+
+vec3 clusteredPointLights(vec3 worldPosition, vec3 normal, vec3 cameraPosition, float viewDepth)
+{
+    uvec2 cluster = clusters[clusterIndex(gl_FragCoord.xy, viewDepth)];
+    vec3 viewDir = normalize(cameraPosition - worldPosition);
+    vec3 result = vec3(0.0);
+
+    for(uint i = 0u; i < cluster.y; i++)
+    {
+        PointLight light = pointLights[lightIndices[cluster.x + i]];
+        vec3 toLight = light.position - worldPosition;
+        float dist = length(toLight);
+        if(dist >= light.radius) continue;
+
+        vec3 lightDir = toLight / dist;
+        float falloff = 1.0 - dist / light.radius;
+        float diffuse = max(dot(normal, lightDir), 0.0);
+        float specular = pow(max(dot(viewDir, reflect(-lightDir, normal)), 0.0), 32.0);
+        result += light.color * light.intensity * falloff * falloff * (diffuse + 0.5 * specular);
+    }
+    return result;
+}
+)";
+
+/* clustered forward lighting. The view frustum is split into tilesX * tilesY * slices froxels
+(exponential depth slices) and every frame each light is binned into the froxels its sphere touches,
+so a fragment only loops over the lights of its own cluster. Needs GL 4.3 for the storage buffers */
+class clusteredLighting{
+    private:
+    struct clusterBox{
+        glm::vec3 min, max; // view space
+    };
+
+    int tilesX, tilesY, slices;
+    float nearPlane, farPlane;
+    int threadCount;
+
+    std::vector<pointLight> lights;
+    std::vector<clusterBox> clusterBoxes;
+    std::vector<unsigned int> clusterData; // offset and count per cluster
+    std::vector<unsigned int> lightIndices;
+
+    //per worker output, merged in order so the result does not depend on timing
+    std::vector<std::vector<unsigned int>> workerIndices;
+    std::vector<glm::vec4> viewLights; // view space position and radius
+
+    glm::mat4 boxesProjection;
+    glBuffer lightBuffer, clusterBuffer, indexBuffer;
+
+    //the depth at which a slice starts, slices are exponential so near clusters stay small
+    float sliceDepth(int slice)
+    {
+        return nearPlane * std::pow(farPlane / nearPlane, (float)slice / slices);
+    }
+
+    //view space boxes of all clusters, only rebuilt when the projection changes
+    void buildClusterBoxes(const glm::mat4 &projection)
+    {
+        glm::mat4 inverseProjection = glm::inverse(projection);
+        clusterBoxes.resize(tilesX * tilesY * slices);
+
+        for(int z = 0; z < slices; z++)
+        {
+            float depthNear = sliceDepth(z);
+            float depthFar = sliceDepth(z + 1);
+
+            for(int y = 0; y < tilesY; y++)
+            {
+                for(int x = 0; x < tilesX; x++)
+                {
+                    clusterBox box = {glm::vec3(1e30f), glm::vec3(-1e30f)};
+
+                    for(int corner = 0; corner < 4; corner++)
+                    {
+                        float ndcX = -1.0f + 2.0f * (x + (corner & 1)) / tilesX;
+                        float ndcY = -1.0f + 2.0f * (y + (corner >> 1)) / tilesY;
+
+                        //ray from the eye through the tile corner, cut at both slice depths
+                        glm::vec4 point = inverseProjection * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+                        glm::vec3 ray = glm::vec3(point) / point.w;
+                        ray /= -ray.z;
+
+                        box.min = glm::min(box.min, glm::min(ray * depthNear, ray * depthFar));
+                        box.max = glm::max(box.max, glm::max(ray * depthNear, ray * depthFar));
+                    }
+                    clusterBoxes[(z * tilesY + y) * tilesX + x] = box;
+                }
+            }
+        }
+        boxesProjection = projection;
+    }
+
+    //bins the lights into the slices [sliceStart, sliceEnd), clusters of those slices are contiguous
+    void binSlices(int worker, int sliceStart, int sliceEnd)
+    {
+        std::vector<unsigned int> &indices = workerIndices[worker];
+        indices.clear();
+
+        for(int z = sliceStart; z < sliceEnd; z++)
+        {
+            float depthNear = sliceDepth(z);
+            float depthFar = sliceDepth(z + 1);
+
+            for(int tile = 0, tiles = tilesX * tilesY; tile < tiles; tile++)
+            {
+                int cluster = z * tiles + tile;
+                const clusterBox &box = clusterBoxes[cluster];
+
+                clusterData[2 * cluster + 0] = indices.size(); // local offset, fixed up after the merge
+                for(int i = 0, s = viewLights.size(); i < s; i++)
+                {
+                    const glm::vec4 &l = viewLights[i];
+
+                    //view space looks down -z
+                    if(-l.z + l.w < depthNear || -l.z - l.w > depthFar)
+                        continue;
+
+                    glm::vec3 closest = glm::clamp(glm::vec3(l), box.min, box.max);
+                    glm::vec3 d = closest - glm::vec3(l);
+                    if(glm::dot(d, d) <= l.w * l.w)
+                        indices.push_back(i);
+                }
+                clusterData[2 * cluster + 1] = indices.size() - clusterData[2 * cluster + 0];
+            }
+        }
+    }
+
+    void upload(glBuffer &buffer, const void* data, size_t size, unsigned int binding)
+    {
+#ifdef GL_VERSION_4_3
+        if(!buffer.valid())
+            buffer.create();
+
+        //glBufferData orphans the old storage so the GPU can keep reading last frame's copy
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer.get());
+        glBufferData(GL_SHADER_STORAGE_BUFFER, std::max(size, (size_t)16), size ? data : NULL, GL_STREAM_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, buffer.get());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+#endif
+    }
+
+    public:
+    clusteredLighting(int tilesX = 16, int tilesY = 9, int slices = 24, float nearPlane = 0.1f, float farPlane = 1000.0f, int threadCount = 0)
+    {
+        this->tilesX = tilesX;
+        this->tilesY = tilesY;
+        this->slices = slices;
+        this->nearPlane = nearPlane;
+        this->farPlane = farPlane;
+
+        if(threadCount <= 0)
+            threadCount = std::max(1u, std::min(8u, std::thread::hardware_concurrency()));
+        this->threadCount = std::min(threadCount, slices);
+
+        workerIndices.resize(this->threadCount);
+        clusterData.resize(2 * tilesX * tilesY * slices, 0);
+        boxesProjection = glm::mat4(0.0f);
+    }
+
+    clusteredLighting(const clusteredLighting&) = delete;
+    clusteredLighting &operator=(const clusteredLighting&) = delete;
+
+    static bool supported()
+    {
+#ifdef GL_VERSION_4_3
+        return GLAD_GL_VERSION_4_3;
+#else
+        return false;
+#endif
+    }
+
+    //has to match the near and far plane of the projection matrix
+    void setDepthRange(float nearPlane, float farPlane)
+    {
+        this->nearPlane = nearPlane;
+        this->farPlane = farPlane;
+        boxesProjection = glm::mat4(0.0f);
+    }
+
+    int addLight(pointLight newLight)
+    {
+        lights.push_back(newLight);
+        return lights.size() - 1;
+    }
+
+    pointLight &getLight(int index)
+    {
+        return lights[index];
+    }
+
+    void clearLights()
+    {
+        lights.clear();
+    }
+
+    int getLightCount()
+    {
+        return lights.size();
+    }
+
+    //bins all lights for this frame on the worker threads and uploads the buffers
+    void update(const glm::mat4 &view, const glm::mat4 &projection)
+    {
+        if(projection != boxesProjection)
+            buildClusterBoxes(projection);
+
+        viewLights.resize(lights.size());
+        for(int i = 0, s = lights.size(); i < s; i++)
+            viewLights[i] = glm::vec4(glm::vec3(view * glm::vec4(lights[i].position, 1.0f)), lights[i].radius);
+
+        int slicesPerWorker = (slices + threadCount - 1) / threadCount;
+
+        //same split as slicesPerWorker, the chunk index picks the worker list
+        engineJobs().parallelRanges(slices, 1, threadCount, [this](int worker, int first, int last){
+            binSlices(worker, first, last);
+        });
+
+        //concatenate the worker lists and turn the local offsets into global ones
+        lightIndices.clear();
+        int clustersPerSlice = tilesX * tilesY;
+        for(int i = 0; i < threadCount; i++)
+        {
+            unsigned int base = lightIndices.size();
+            int first = std::min(slices, i * slicesPerWorker) * clustersPerSlice;
+            int last = std::min(slices, (i + 1) * slicesPerWorker) * clustersPerSlice;
+
+            for(int cluster = first; cluster < last; cluster++)
+                clusterData[2 * cluster + 0] += base;
+
+            lightIndices.insert(lightIndices.end(), workerIndices[i].begin(), workerIndices[i].end());
+        }
+
+        if(!supported())
+            return;
+
+        upload(lightBuffer, lights.data(), lights.size() * sizeof(pointLight), POINT_LIGHT_BINDING);
+        upload(clusterBuffer, clusterData.data(), clusterData.size() * sizeof(unsigned int), CLUSTER_BINDING);
+        upload(indexBuffer, lightIndices.data(), lightIndices.size() * sizeof(unsigned int), LIGHT_INDEX_BINDING);
+    }
+
+    //uniforms read by clusteredLightingGLSL, the shader has to be in use
+    void setUniforms(shader *lightingShader, float screenWidth, float screenHeight)
+    {
+        glUniform3ui(glGetUniformLocation(lightingShader->progID.get(), "clusterCounts"), tilesX, tilesY, slices);
+        lightingShader->setVec2("clusterNearFar", nearPlane, farPlane);
+        lightingShader->setVec2("screenSize", screenWidth, screenHeight);
+    }
+
+    //lights of one cluster, mostly for debugging
+    int getClusterLightCount(int x, int y, int z)
+    {
+        return clusterData[2 * ((z * tilesY + y) * tilesX + x) + 1];
+    }
+
+    int getTotalAssignments()
+    {
+        return lightIndices.size();
+    }
+};
+
+#endif
@@ -0,0 +1,298 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <vector>
+#include <memory_resource>
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#include <cstdint>
+#include <algorithm>
+
+/* heap allocations made through operator new. Counting needs the global operator new replaced, which may
+only happen once per program: define ENGINE_COUNT_ALLOCATIONS in exactly one source file before including
+this header. Without it the count stays 0 */
+inline std::atomic<long long> &heapAllocationCount()
+{
+    static std::atomic<long long> count{0};
+    return count;
+}
+
+#ifdef ENGINE_COUNT_ALLOCATIONS
+void *operator new(size_t size)
+{
+    heapAllocationCount().fetch_add(1, std::memory_order_relaxed);
+    void *pointer = std::malloc(size > 0 ? size : 1);
+    if(pointer == NULL)
+        throw std::bad_alloc();
+    return pointer;
+}
+
+void operator delete(void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept
+{
+    std::free(pointer);
+}
+#endif
+
+/* bump allocator for memory that only lives for one frame. Allocating moves an offset, deallocating does
+nothing and reset() at the end of the frame frees everything at once. A frame that does not fit is served
+from the heap and the buffer grows to the high water mark on the next reset(), so after the first frames
+it never touches the heap again. Not thread safe, one arena per thread */
+class frameArena : public std::pmr::memory_resource{
+    private:
+    unsigned char *buffer = NULL;
+    size_t capacity = 0;
+    size_t offset = 0;
+    size_t peak = 0;
+
+    struct overflowBlock{
+        void *pointer;
+        size_t alignment;
+    };
+    std::vector<overflowBlock> overflow;
+    size_t overflowBytes = 0;
+
+    void *do_allocate(size_t bytes, size_t alignment) override
+    {
+        uintptr_t base = (uintptr_t)buffer;
+        uintptr_t start = (base + offset + alignment - 1) & ~(uintptr_t)(alignment - 1);
+
+        if(buffer != NULL && start + bytes <= base + capacity)
+        {
+            offset = start + bytes - base;
+            peak = std::max(peak, offset);
+            return (void*)start;
+        }
+
+        //does not fit, this frame takes it from the heap and reset() makes room for it
+        void *pointer = ::operator new(bytes, std::align_val_t(alignment));
+        overflow.push_back({pointer, alignment});
+        overflowBytes += bytes + alignment;
+        return pointer;
+    }
+
+    void do_deallocate(void*, size_t, size_t) override
+    {
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+    {
+        return this == &other;
+    }
+
+    public:
+    frameArena(size_t capacity = 1 << 20)
+    {
+        reserve(capacity);
+    }
+
+    frameArena(const frameArena&) = delete;
+    frameArena &operator=(const frameArena&) = delete;
+
+    ~frameArena()
+    {
+        reset();
+        ::operator delete(buffer);
+    }
+
+    //only between frames, the old buffer is freed
+    void reserve(size_t bytes)
+    {
+        if(bytes <= capacity)
+            return;
+
+        ::operator delete(buffer);
+        buffer = (unsigned char*)::operator new(bytes);
+        capacity = bytes;
+        offset = 0;
+    }
+
+    //frees everything allocated since the last reset, everything made from the arena must be gone by then
+    void reset()
+    {
+        for(const overflowBlock &block : overflow)
+            ::operator delete(block.pointer, std::align_val_t(block.alignment));
+        overflow.clear();
+
+        if(overflowBytes > 0)
+            reserve((offset + overflowBytes) * 3 / 2);
+
+        offset = 0;
+        overflowBytes = 0;
+    }
+
+    //typed allocation for arrays that are filled by hand, not constructed
+    template<typename T>
+    T *allocateArray(size_t count)
+    {
+        return (T*)allocate(count * sizeof(T), alignof(T));
+    }
+
+    size_t getUsed()
+    {
+        return offset + overflowBytes;
+    }
+
+    size_t getCapacity()
+    {
+        return capacity;
+    }
+
+    //most bytes one frame used
+    size_t getPeak()
+    {
+        return peak;
+    }
+};
+
+/* fixed size blocks with a free list, for components and contacts that are created and destroyed one at a
+time. Blocks come from chunks of blocksPerChunk that are only released with the pool. Requests bigger than
+the block size go to the heap, so the pool also works behind node based containers (std::pmr::list, map) */
+class blockPool : public std::pmr::memory_resource{
+    private:
+    struct freeBlock{
+        freeBlock *next;
+    };
+
+    size_t blockSize;
+    int blocksPerChunk;
+    std::vector<void*> chunks;
+    freeBlock *freeList = NULL;
+    int used = 0;
+
+    static const size_t blockAlignment = alignof(std::max_align_t);
+
+    void addChunk()
+    {
+        unsigned char *chunk = (unsigned char*)::operator new(blockSize * blocksPerChunk);
+        chunks.push_back(chunk);
+
+        for(int i = blocksPerChunk - 1; i >= 0; i--)
+        {
+            freeBlock *block = (freeBlock*)(chunk + i * blockSize);
+            block->next = freeList;
+            freeList = block;
+        }
+    }
+
+    bool fits(size_t bytes, size_t alignment)
+    {
+        return bytes <= blockSize && alignment <= blockAlignment;
+    }
+
+    void *do_allocate(size_t bytes, size_t alignment) override
+    {
+        if(!fits(bytes, alignment))
+            return ::operator new(bytes, std::align_val_t(alignment));
+
+        if(freeList == NULL)
+            addChunk();
+
+        freeBlock *block = freeList;
+        freeList = block->next;
+        used++;
+        return block;
+    }
+
+    void do_deallocate(void *pointer, size_t bytes, size_t alignment) override
+    {
+        if(!fits(bytes, alignment))
+        {
+            ::operator delete(pointer, std::align_val_t(alignment));
+            return;
+        }
+
+        freeBlock *block = (freeBlock*)pointer;
+        block->next = freeList;
+        freeList = block;
+        used--;
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+    {
+        return this == &other;
+    }
+
+    public:
+    blockPool(size_t blockSize, int blocksPerChunk = 256)
+    {
+        //every block has to hold the free list link and keep the next block aligned
+        blockSize = std::max(blockSize, sizeof(freeBlock));
+        this->blockSize = (blockSize + blockAlignment - 1) / blockAlignment * blockAlignment;
+        this->blocksPerChunk = std::max(1, blocksPerChunk);
+    }
+
+    blockPool(const blockPool&) = delete;
+    blockPool &operator=(const blockPool&) = delete;
+
+    ~blockPool()
+    {
+        for(void *chunk : chunks)
+            ::operator delete(chunk);
+    }
+
+    //allocates the chunks for count blocks up front
+    void reserve(int count)
+    {
+        while((int)chunks.size() * blocksPerChunk < count)
+            addChunk();
+    }
+
+    template<typename T, typename... Args>
+    T *create(Args&&... args)
+    {
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    template<typename T>
+    void destroy(T *object)
+    {
+        object->~T();
+        deallocate(object, sizeof(T), alignof(T));
+    }
+
+    int getUsedBlocks()
+    {
+        return used;
+    }
+
+    size_t getBlockSize()
+    {
+        return blockSize;
+    }
+};
+
+//containers that take their memory from an arena or pool, std::vector otherwise
+template<typename T>
+using frameVector = std::pmr::vector<T>;
+
+//arena of the main thread, reset by endFrameMemory()
+frameArena frameMemory;
+
+struct frameMemoryReport{
+    long long heapAllocations; // since the last report, 0 without ENGINE_COUNT_ALLOCATIONS
+    size_t arenaBytes; // frameMemory used this frame
+    size_t arenaCapacity;
+};
+
+//call once at the end of every frame, a steady frame reports no heap allocations
+inline frameMemoryReport endFrameMemory()
+{
+    static long long lastCount = 0;
+    size_t used = frameMemory.getUsed();
+
+    //growing the arena is counted in the frame that overflowed it
+    frameMemory.reset();
+    long long count = heapAllocationCount().load(std::memory_order_relaxed);
+
+    frameMemoryReport report = {count - lastCount, used, frameMemory.getCapacity()};
+    lastCount = count;
+    return report;
+}
+
+#endif
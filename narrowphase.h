@@ -0,0 +1,1158 @@
+#ifndef NARROWPHASE_H
+#define NARROWPHASE_H
+
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <array>
+#include <utility>
+#include <iostream>
+
+#include <glm/glm.hpp>
+
+/* struct used in collision system to know the if collision has occured,
+the overlap between the colliding objects and the collision normal */
+struct collided{
+    bool hasCollided = false;
+    float overlap = 0.0f;
+    glm::vec3 normal = glm::vec3(0.0f, 0.0f, 0.0f);
+};
+
+//bounding volumes in world space, used by the visibility system and the narrowphase
+struct boundingBox{
+    glm::vec3 min = glm::vec3(0.0f, 0.0f, 0.0f);
+    glm::vec3 max = glm::vec3(0.0f, 0.0f, 0.0f);
+};
+
+struct boundingSphere{
+    glm::vec3 center = glm::vec3(0.0f, 0.0f, 0.0f);
+    float radius = 0.0f;
+};
+
+//collider types, the order is the index into the pair test tables
+enum shapeType{
+    SHAPE_AABB,
+    SHAPE_SPHERE,
+    SHAPE_OBB,
+    SHAPE_CAPSULE,
+    SHAPE_CONVEX,
+    SHAPE_COUNT
+};
+
+//box with its own axes, the half extents are measured along them
+struct orientedBox{
+    glm::vec3 center = glm::vec3(0.0f, 0.0f, 0.0f);
+    glm::vec3 axes[3] = {glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f)};
+    glm::vec3 halfExtents = glm::vec3(0.0f, 0.0f, 0.0f);
+};
+
+//segment from a to b grown by the radius
+struct capsuleSegment{
+    glm::vec3 a = glm::vec3(0.0f, 0.0f, 0.0f);
+    glm::vec3 b = glm::vec3(0.0f, 0.0f, 0.0f);
+    float radius = 0.0f;
+};
+
+//world space points of a convex hull, owned by the object the shape was made from
+struct convexHull{
+    const glm::vec3 *points = NULL;
+    int count = 0;
+};
+
+/* world space collider of an object, computed once per step so the pair tests only read plain data.
+The type picks which of the volumes is used, box always holds the world bounds of the collider */
+struct collisionShape{
+    boundingBox box;
+    boundingSphere sphere;
+    orientedBox obb;
+    capsuleSegment capsule;
+    convexHull hull;
+    int type = SHAPE_AABB;
+    bool hasCollision = false;
+};
+
+//two objects whose bounds overlap, indices into the world's object list with a < b
+struct bodyPair{
+    int a;
+    int b;
+};
+
+//result of one pair test, a and b index the shapes it was computed from
+struct contact{
+    int a;
+    int b;
+    collided result;
+};
+
+//boxes with no depth are 2D, two of them on the same plane are only tested in x and y
+inline collided testAABB(const boundingBox &a, const boundingBox &b)
+{
+    bool flat = a.min.z == a.max.z && b.min.z == a.min.z && b.max.z == a.min.z;
+
+    bool overlap = a.min.x < b.max.x && a.max.x > b.min.x &&
+                   a.min.y < b.max.y && a.max.y > b.min.y &&
+                   (flat || (a.min.z < b.max.z && a.max.z > b.min.z));
+
+    if(!overlap)
+        return {false, 0.0f, glm::vec3(0.0f)};
+
+    //push out along the axis of least overlap, flat boxes only in x and y
+    float depths[6] = {
+        b.max.x - a.min.x,   // +X
+        a.max.x - b.min.x,   // -X
+        b.max.y - a.min.y,   // +Y
+        a.max.y - b.min.y,   // -Y
+        b.max.z - a.min.z,   // +Z
+        a.max.z - b.min.z    // -Z
+    };
+    const glm::vec3 normals[6] = {
+        glm::vec3(-1, 0, 0), // push left
+        glm::vec3(1, 0, 0),  // push right
+        glm::vec3(0, -1, 0), // push down
+        glm::vec3(0, 1, 0),  // push up
+        glm::vec3(0, 0, -1), // push back
+        glm::vec3(0, 0, 1)   // push forward
+    };
+
+    int minIndex = -1;
+    for(int i = 0, axes = flat ? 4 : 6; i < axes; i++)
+    {
+        if(depths[i] < 0) continue;
+        if(minIndex < 0 || depths[i] < depths[minIndex])
+            minIndex = i;
+    }
+
+    if(minIndex < 0)
+        return {true, 0.0f, glm::vec3(0.0f)};
+
+    return {true, depths[minIndex], normals[minIndex]};
+}
+
+//the normal points from a to b
+inline collided testSpheres(const boundingSphere &a, const boundingSphere &b)
+{
+    glm::vec3 axis = b.center - a.center;
+    float distSquared = glm::dot(axis, axis);
+    float radii = a.radius + b.radius;
+
+    if(distSquared > radii * radii)
+        return {false, 0.0f, glm::vec3(0.0f)};
+
+    float dist = std::sqrt(distSquared);
+
+    // Handle zero distance (perfect overlap) to avoid divide-by-zero
+    if(dist != 0.0f)
+        axis /= dist;
+    else
+        axis = glm::vec3(1.0f, 0.0f, 0.0f);
+
+    return {true, radii - dist, axis};
+}
+
+/* like the other tests the normal points from the first shape of the pair towards the second one.
+For flat boxes z is taken from the sphere center, the same as the 2D game always did */
+inline collided testSphereAABB(const boundingSphere &sphere, const boundingBox &box, bool sphereFirst)
+{
+    glm::vec3 closest(std::max(box.min.x, std::min(sphere.center.x, box.max.x)),
+                      std::max(box.min.y, std::min(sphere.center.y, box.max.y)),
+                      box.min.z == box.max.z ? sphere.center.z : std::max(box.min.z, std::min(sphere.center.z, box.max.z)));
+
+    glm::vec3 normal = closest - sphere.center;
+    float distSquared = glm::dot(normal, normal);
+
+    if(distSquared > sphere.radius * sphere.radius)
+        return {false, 0.0f, glm::vec3(0.0f)};
+
+    float dist = std::sqrt(distSquared);
+
+    //center inside the box, push up like a landing
+    if(dist != 0.0f)
+        normal /= dist;
+    else
+        normal = glm::vec3(0.0f, -1.0f, 0.0f);
+
+    return {true, sphere.radius - dist, sphereFirst ? normal : -normal};
+}
+
+inline orientedBox toOrientedBox(const boundingBox &box)
+{
+    orientedBox result;
+    result.center = (box.min + box.max) * 0.5f;
+    result.halfExtents = (box.max - box.min) * 0.5f;
+    return result;
+}
+
+//sphere against a box with its own axes, a center inside the box leaves through the nearest face
+inline collided testSphereOBB(const boundingSphere &sphere, const orientedBox &box, bool sphereFirst)
+{
+    glm::vec3 offset = sphere.center - box.center;
+    glm::vec3 local(glm::dot(offset, box.axes[0]), glm::dot(offset, box.axes[1]), glm::dot(offset, box.axes[2]));
+    glm::vec3 clamped = glm::clamp(local, -box.halfExtents, box.halfExtents);
+
+    glm::vec3 normal;
+    float overlap;
+
+    if(local != clamped)
+    {
+        glm::vec3 closest = box.center + box.axes[0] * clamped.x + box.axes[1] * clamped.y + box.axes[2] * clamped.z;
+        normal = closest - sphere.center;
+
+        float distSquared = glm::dot(normal, normal);
+        if(distSquared > sphere.radius * sphere.radius)
+            return {false, 0.0f, glm::vec3(0.0f)};
+
+        float dist = std::sqrt(distSquared);
+        normal /= dist;
+        overlap = sphere.radius - dist;
+    }
+    else
+    {
+        //flat axes of a 2D box are skipped, the sphere cannot leave through them
+        int axis = -1;
+        float depth = 0.0f;
+        for(int k = 0; k < 3; k++)
+        {
+            if(box.halfExtents[k] <= 0.0f)
+                continue;
+
+            float d = box.halfExtents[k] - std::abs(local[k]);
+            if(axis < 0 || d < depth)
+            {
+                axis = k;
+                depth = d;
+            }
+        }
+        if(axis < 0)
+            return {true, sphere.radius, sphereFirst ? glm::vec3(0.0f, -1.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f)};
+
+        normal = local[axis] >= 0.0f ? -box.axes[axis] : box.axes[axis];
+        overlap = sphere.radius + depth;
+    }
+
+    return {true, overlap, sphereFirst ? normal : -normal};
+}
+
+/* separating axis test of two oriented boxes: 3 face axes of each box and the 9 edge cross products.
+Axes both boxes have no extent along (the z axis of two 2D boxes in one plane) are skipped */
+inline collided testOBB(const orientedBox &a, const orientedBox &b)
+{
+    glm::vec3 offset = b.center - a.center;
+    float best = 0.0f;
+    glm::vec3 bestAxis(0.0f);
+    bool found = false;
+
+    //false when the axis separates the boxes, edge axes only win by a margin so resting faces stay stable
+    auto testAxis = [&](glm::vec3 axis, float margin) -> bool {
+        float lengthSquared = glm::dot(axis, axis);
+        if(lengthSquared < 1e-8f)
+            return true;
+        axis /= std::sqrt(lengthSquared);
+
+        float ra = a.halfExtents.x * std::abs(glm::dot(a.axes[0], axis)) + a.halfExtents.y * std::abs(glm::dot(a.axes[1], axis)) + a.halfExtents.z * std::abs(glm::dot(a.axes[2], axis));
+        float rb = b.halfExtents.x * std::abs(glm::dot(b.axes[0], axis)) + b.halfExtents.y * std::abs(glm::dot(b.axes[1], axis)) + b.halfExtents.z * std::abs(glm::dot(b.axes[2], axis));
+        float distance = glm::dot(offset, axis);
+
+        if(ra + rb < 1e-6f)
+            return std::abs(distance) < 1e-6f;
+
+        float depth = ra + rb - std::abs(distance);
+        if(depth <= 0.0f)
+            return false;
+
+        if(!found || depth + margin < best)
+        {
+            best = depth;
+            bestAxis = distance < 0.0f ? -axis : axis;
+            found = true;
+        }
+        return true;
+    };
+
+    for(int i = 0; i < 3; i++)
+    {
+        if(!testAxis(a.axes[i], 0.0f) || !testAxis(b.axes[i], 0.0f))
+            return {false, 0.0f, glm::vec3(0.0f)};
+    }
+
+    for(int i = 0; i < 3; i++)
+    {
+        for(int j = 0; j < 3; j++)
+        {
+            if(!testAxis(glm::cross(a.axes[i], b.axes[j]), 1e-3f))
+                return {false, 0.0f, glm::vec3(0.0f)};
+        }
+    }
+
+    if(!found)
+        return {true, 0.0f, glm::vec3(0.0f)};
+    return {true, best, bestAxis};
+}
+
+inline glm::vec3 closestOnSegment(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &point)
+{
+    glm::vec3 ab = b - a;
+    float lengthSquared = glm::dot(ab, ab);
+    float t = lengthSquared > 0.0f ? glm::clamp(glm::dot(point - a, ab) / lengthSquared, 0.0f, 1.0f) : 0.0f;
+    return a + ab * t;
+}
+
+//closest points of the segments p1-q1 and p2-q2
+inline void closestOnSegments(const glm::vec3 &p1, const glm::vec3 &q1, const glm::vec3 &p2, const glm::vec3 &q2, glm::vec3 &c1, glm::vec3 &c2)
+{
+    glm::vec3 d1 = q1 - p1;
+    glm::vec3 d2 = q2 - p2;
+    glm::vec3 r = p1 - p2;
+    float a = glm::dot(d1, d1);
+    float e = glm::dot(d2, d2);
+    float f = glm::dot(d2, r);
+    float s = 0.0f, t = 0.0f;
+
+    if(a <= 1e-12f && e <= 1e-12f)
+    {
+        s = t = 0.0f;
+    }
+    else if(a <= 1e-12f)
+    {
+        t = glm::clamp(f / e, 0.0f, 1.0f);
+    }
+    else
+    {
+        float c = glm::dot(d1, r);
+        if(e <= 1e-12f)
+        {
+            s = glm::clamp(-c / a, 0.0f, 1.0f);
+        }
+        else
+        {
+            float b = glm::dot(d1, d2);
+            float denominator = a * e - b * b;
+
+            //parallel segments pick any point of the first one
+            s = denominator != 0.0f ? glm::clamp((b * f - c * e) / denominator, 0.0f, 1.0f) : 0.0f;
+            t = (b * s + f) / e;
+
+            if(t < 0.0f)
+            {
+                t = 0.0f;
+                s = glm::clamp(-c / a, 0.0f, 1.0f);
+            }
+            else if(t > 1.0f)
+            {
+                t = 1.0f;
+                s = glm::clamp((b - c) / a, 0.0f, 1.0f);
+            }
+        }
+    }
+
+    c1 = p1 + d1 * s;
+    c2 = p2 + d2 * t;
+}
+
+//farthest point of the shape in the direction, what GJK and EPA know about a shape
+template<int TYPE> inline glm::vec3 supportPoint(const collisionShape &shape, const glm::vec3 &direction);
+
+template<> inline glm::vec3 supportPoint<SHAPE_AABB>(const collisionShape &shape, const glm::vec3 &direction)
+{
+    return glm::vec3(direction.x >= 0.0f ? shape.box.max.x : shape.box.min.x,
+                     direction.y >= 0.0f ? shape.box.max.y : shape.box.min.y,
+                     direction.z >= 0.0f ? shape.box.max.z : shape.box.min.z);
+}
+
+template<> inline glm::vec3 supportPoint<SHAPE_SPHERE>(const collisionShape &shape, const glm::vec3 &direction)
+{
+    float length = glm::length(direction);
+    return length > 0.0f ? shape.sphere.center + direction * (shape.sphere.radius / length) : shape.sphere.center;
+}
+
+template<> inline glm::vec3 supportPoint<SHAPE_OBB>(const collisionShape &shape, const glm::vec3 &direction)
+{
+    glm::vec3 point = shape.obb.center;
+    for(int i = 0; i < 3; i++)
+        point += shape.obb.axes[i] * (glm::dot(direction, shape.obb.axes[i]) >= 0.0f ? shape.obb.halfExtents[i] : -shape.obb.halfExtents[i]);
+    return point;
+}
+
+template<> inline glm::vec3 supportPoint<SHAPE_CAPSULE>(const collisionShape &shape, const glm::vec3 &direction)
+{
+    const capsuleSegment &c = shape.capsule;
+    glm::vec3 end = glm::dot(direction, c.b - c.a) >= 0.0f ? c.b : c.a;
+
+    float length = glm::length(direction);
+    return length > 0.0f ? end + direction * (c.radius / length) : end;
+}
+
+template<> inline glm::vec3 supportPoint<SHAPE_CONVEX>(const collisionShape &shape, const glm::vec3 &direction)
+{
+    const convexHull &hull = shape.hull;
+    if(hull.count == 0)
+        return (shape.box.min + shape.box.max) * 0.5f;
+
+    int best = 0;
+    float bestDot = glm::dot(hull.points[0], direction);
+    for(int i = 1; i < hull.count; i++)
+    {
+        float d = glm::dot(hull.points[i], direction);
+        if(d > bestDot)
+        {
+            bestDot = d;
+            best = i;
+        }
+    }
+    return hull.points[best];
+}
+
+/* support of the minkowski difference a - b. Two 2D shapes in one plane are stretched far along z
+so EPA never picks the z axis to push out along, the same rule as the flat boxes of testAABB */
+template<int A, int B> struct minkowskiDifference{
+    const collisionShape &a;
+    const collisionShape &b;
+    float extrude;
+
+    glm::vec3 operator()(const glm::vec3 &direction) const
+    {
+        glm::vec3 point = supportPoint<A>(a, direction) - supportPoint<B>(b, -direction);
+        if(extrude > 0.0f)
+            point.z += direction.z >= 0.0f ? extrude : -extrude;
+        return point;
+    }
+};
+
+struct gjkSimplex{
+    glm::vec3 points[4]; // newest first
+    int size = 0;
+
+    void push(const glm::vec3 &point)
+    {
+        for(int i = std::min(size, 3); i > 0; i--)
+            points[i] = points[i - 1];
+        points[0] = point;
+        size = std::min(size + 1, 4);
+    }
+};
+
+inline bool gjkLine(gjkSimplex &s, glm::vec3 &direction)
+{
+    glm::vec3 a = s.points[0], b = s.points[1];
+    glm::vec3 ab = b - a, ao = -a;
+
+    if(glm::dot(ab, ao) > 0.0f)
+        direction = glm::cross(glm::cross(ab, ao), ab);
+    else
+    {
+        s.size = 1;
+        direction = ao;
+    }
+    return false;
+}
+
+inline bool gjkTriangle(gjkSimplex &s, glm::vec3 &direction)
+{
+    glm::vec3 a = s.points[0], b = s.points[1], c = s.points[2];
+    glm::vec3 ab = b - a, ac = c - a, ao = -a;
+    glm::vec3 abc = glm::cross(ab, ac);
+
+    if(glm::dot(glm::cross(abc, ac), ao) > 0.0f)
+    {
+        if(glm::dot(ac, ao) > 0.0f)
+        {
+            s.points[1] = c;
+            s.size = 2;
+            direction = glm::cross(glm::cross(ac, ao), ac);
+            return false;
+        }
+        s.size = 2;
+        return gjkLine(s, direction);
+    }
+
+    if(glm::dot(glm::cross(ab, abc), ao) > 0.0f)
+    {
+        s.size = 2;
+        return gjkLine(s, direction);
+    }
+
+    if(glm::dot(abc, ao) > 0.0f)
+        direction = abc;
+    else
+    {
+        s.points[1] = c;
+        s.points[2] = b;
+        direction = -abc;
+    }
+    return false;
+}
+
+inline bool gjkTetrahedron(gjkSimplex &s, glm::vec3 &direction)
+{
+    glm::vec3 a = s.points[0], b = s.points[1], c = s.points[2], d = s.points[3];
+    glm::vec3 ab = b - a, ac = c - a, ad = d - a, ao = -a;
+
+    glm::vec3 abc = glm::cross(ab, ac);
+    glm::vec3 acd = glm::cross(ac, ad);
+    glm::vec3 adb = glm::cross(ad, ab);
+
+    if(glm::dot(abc, ao) > 0.0f)
+    {
+        s.size = 3;
+        return gjkTriangle(s, direction);
+    }
+    if(glm::dot(acd, ao) > 0.0f)
+    {
+        s.points[1] = c;
+        s.points[2] = d;
+        s.size = 3;
+        return gjkTriangle(s, direction);
+    }
+    if(glm::dot(adb, ao) > 0.0f)
+    {
+        s.points[1] = d;
+        s.points[2] = b;
+        s.size = 3;
+        return gjkTriangle(s, direction);
+    }
+    return true;
+}
+
+//grows a simplex that ended flat (origin on a point, segment or triangle) into a tetrahedron for EPA
+template<typename SUPPORT> inline bool completeSimplex(gjkSimplex &s, const SUPPORT &support)
+{
+    static const glm::vec3 axes[6] = {
+        glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0),
+        glm::vec3(0, -1, 0), glm::vec3(0, 0, 1), glm::vec3(0, 0, -1)
+    };
+    const float epsilon = 1e-6f;
+
+    if(s.size == 1)
+    {
+        for(const glm::vec3 &axis : axes)
+        {
+            glm::vec3 p = support(axis);
+            if(glm::length(p - s.points[0]) > epsilon)
+            {
+                s.push(p);
+                break;
+            }
+        }
+    }
+
+    if(s.size == 2)
+    {
+        glm::vec3 line = s.points[1] - s.points[0];
+        for(const glm::vec3 &axis : axes)
+        {
+            glm::vec3 side = glm::cross(line, axis);
+            if(glm::dot(side, side) < epsilon)
+                continue;
+
+            glm::vec3 p = support(side);
+            if(glm::length(glm::cross(p - s.points[0], line)) > epsilon)
+            {
+                s.push(p);
+                break;
+            }
+        }
+    }
+
+    if(s.size == 3)
+    {
+        glm::vec3 normal = glm::cross(s.points[1] - s.points[0], s.points[2] - s.points[0]);
+        glm::vec3 p = support(normal);
+        if(std::abs(glm::dot(p - s.points[0], normal)) < epsilon)
+            p = support(-normal);
+        if(std::abs(glm::dot(p - s.points[0], normal)) < epsilon)
+            return false;
+        s.push(p);
+    }
+
+    return s.size == 4;
+}
+
+/* expanding polytope algorithm: grows the simplex around the origin towards the surface of the minkowski
+difference until the nearest face stops moving, that face gives the normal and the depth.
+Fixed size buffers, a polytope that runs out of room returns the best face found so far */
+template<typename SUPPORT> inline collided expandPolytope(const gjkSimplex &s, const SUPPORT &support)
+{
+    const int maxVertices = 64;
+    const int maxFaces = 128;
+    const int maxEdges = 192;
+
+    struct face{
+        int a, b, c;
+        glm::vec3 normal;
+        float distance;
+    };
+
+    glm::vec3 vertices[maxVertices];
+    face faces[maxFaces];
+    int edges[maxEdges][2];
+    int vertexCount = 4, faceCount = 0;
+
+    for(int i = 0; i < 4; i++)
+        vertices[i] = s.points[i];
+
+    glm::vec3 inside = (vertices[0] + vertices[1] + vertices[2] + vertices[3]) * 0.25f;
+
+    //normals point away from the inside of the polytope
+    auto addFace = [&](int a, int b, int c) -> bool {
+        glm::vec3 normal = glm::cross(vertices[b] - vertices[a], vertices[c] - vertices[a]);
+        float length = glm::length(normal);
+        if(length < 1e-12f || faceCount >= maxFaces)
+            return false;
+
+        normal /= length;
+        if(glm::dot(normal, vertices[a] - inside) < 0.0f)
+        {
+            std::swap(b, c);
+            normal = -normal;
+        }
+        faces[faceCount++] = {a, b, c, normal, glm::dot(normal, vertices[a])};
+        return true;
+    };
+
+    addFace(0, 1, 2);
+    addFace(0, 3, 1);
+    addFace(0, 2, 3);
+    addFace(1, 3, 2);
+    if(faceCount < 4)
+        return {true, 0.0f, glm::vec3(0.0f)};
+
+    int closest = 0;
+    for(int iteration = 0; iteration < 32; iteration++)
+    {
+        closest = 0;
+        for(int i = 1; i < faceCount; i++)
+        {
+            if(faces[i].distance < faces[closest].distance)
+                closest = i;
+        }
+
+        glm::vec3 normal = faces[closest].normal;
+        glm::vec3 p = support(normal);
+        float distance = glm::dot(p, normal);
+
+        if(distance - faces[closest].distance < 1e-4f * std::max(1.0f, faces[closest].distance) || vertexCount >= maxVertices)
+            break;
+
+        //faces that see the new point go, the edges only one of them had form the hole to fill
+        int edgeCount = 0;
+        bool overflow = false;
+        vertices[vertexCount] = p;
+
+        for(int i = 0; i < faceCount; i++)
+        {
+            const face &f = faces[i];
+            if(glm::dot(f.normal, p - vertices[f.a]) <= 0.0f)
+                continue;
+
+            int corners[3] = {f.a, f.b, f.c};
+            for(int e = 0; e < 3; e++)
+            {
+                int from = corners[e], to = corners[(e + 1) % 3];
+
+                int shared = -1;
+                for(int j = 0; j < edgeCount; j++)
+                {
+                    if(edges[j][0] == to && edges[j][1] == from)
+                    {
+                        shared = j;
+                        break;
+                    }
+                }
+
+                if(shared >= 0)
+                {
+                    edges[shared][0] = edges[edgeCount - 1][0];
+                    edges[shared][1] = edges[edgeCount - 1][1];
+                    edgeCount--;
+                }
+                else if(edgeCount < maxEdges)
+                {
+                    edges[edgeCount][0] = from;
+                    edges[edgeCount][1] = to;
+                    edgeCount++;
+                }
+                else
+                    overflow = true;
+            }
+
+            faces[i] = faces[--faceCount];
+            i--;
+        }
+
+        if(overflow || faceCount + edgeCount > maxFaces)
+            break;
+
+        int added = vertexCount++;
+        for(int j = 0; j < edgeCount; j++)
+            addFace(edges[j][0], edges[j][1], added);
+
+        if(faceCount == 0)
+            return {true, 0.0f, glm::vec3(0.0f)};
+    }
+
+    closest = 0;
+    for(int i = 1; i < faceCount; i++)
+    {
+        if(faces[i].distance < faces[closest].distance)
+            closest = i;
+    }
+    return {true, std::max(0.0f, faces[closest].distance), faces[closest].normal};
+}
+
+/* GJK for any two convex shapes, EPA for the normal and depth when they overlap.
+Specialized for every shape pair through the support functions */
+template<int A, int B> inline collided testConvexPair(const collisionShape &a, const collisionShape &b)
+{
+    float centerA = (a.box.min.z + a.box.max.z) * 0.5f;
+    float centerB = (b.box.min.z + b.box.max.z) * 0.5f;
+    bool flat = centerA == centerB && (a.box.min.z == a.box.max.z || b.box.min.z == b.box.max.z);
+
+    glm::vec3 extent = glm::max(a.box.max - a.box.min, b.box.max - b.box.min);
+    minkowskiDifference<A, B> support = {a, b, flat ? 4.0f * (extent.x + extent.y) + 1.0f : 0.0f};
+
+    glm::vec3 direction = (a.box.min + a.box.max) * 0.5f - (b.box.min + b.box.max) * 0.5f;
+    if(glm::dot(direction, direction) < 1e-12f)
+        direction = glm::vec3(1.0f, 0.0f, 0.0f);
+
+    gjkSimplex simplex;
+    simplex.push(support(direction));
+    direction = -simplex.points[0];
+
+    bool enclosed = false;
+    for(int iteration = 0; iteration < 64; iteration++)
+    {
+        //origin on the simplex, the shapes touch
+        if(glm::dot(direction, direction) < 1e-12f)
+        {
+            enclosed = true;
+            break;
+        }
+
+        glm::vec3 p = support(direction);
+        if(glm::dot(p, direction) <= 0.0f)
+            return {false, 0.0f, glm::vec3(0.0f)};
+
+        simplex.push(p);
+
+        bool done = false;
+        if(simplex.size == 2) done = gjkLine(simplex, direction);
+        else if(simplex.size == 3) done = gjkTriangle(simplex, direction);
+        else done = gjkTetrahedron(simplex, direction);
+
+        if(done)
+        {
+            enclosed = true;
+            break;
+        }
+    }
+
+    if(!enclosed || !completeSimplex(simplex, support))
+        return {enclosed, 0.0f, glm::vec3(0.0f)};
+
+    return expandPolytope(simplex, support);
+}
+
+/* test kernel of one shape pair. Pairs without their own kernel run GJK/EPA, pairs listed the other way
+around run the kernel of the swapped pair and flip the normal */
+template<int A, int B, bool ORDERED = (A <= B)> struct pairKernel{
+    static collided test(const collisionShape &a, const collisionShape &b)
+    {
+        return testConvexPair<A, B>(a, b);
+    }
+};
+
+template<int A, int B> struct pairKernel<A, B, false>{
+    static collided test(const collisionShape &a, const collisionShape &b)
+    {
+        collided result = pairKernel<B, A>::test(b, a);
+        result.normal = -result.normal;
+        return result;
+    }
+};
+
+template<> struct pairKernel<SHAPE_AABB, SHAPE_AABB, true>{
+    static collided test(const collisionShape &a, const collisionShape &b)
+    {
+        return testAABB(a.box, b.box);
+    }
+};
+
+template<> struct pairKernel<SHAPE_AABB, SHAPE_SPHERE, true>{
+    static collided test(const collisionShape &a, const collisionShape &b)
+    {
+        return testSphereAABB(b.sphere, a.box, false);
+    }
+};
+
+template<> struct pairKernel<SHAPE_AABB, SHAPE_OBB, true>{
+    static collided test(const collisionShape &a, const collisionShape &b)
+    {
+        return testOBB(toOrientedBox(a.box), b.obb);
+    }
+};
+
+template<> struct pairKernel<SHAPE_SPHERE, SHAPE_SPHERE, true>{
+    static collided test(const collisionShape &a, const collisionShape &b)
+    {
+        return testSpheres(a.sphere, b.sphere);
+    }
+};
+
+template<> struct pairKernel<SHAPE_SPHERE, SHAPE_OBB, true>{
+    static collided test(const collisionShape &a, const collisionShape &b)
+    {
+        return testSphereOBB(a.sphere, b.obb, true);
+    }
+};
+
+template<> struct pairKernel<SHAPE_SPHERE, SHAPE_CAPSULE, true>{
+    static collided test(const collisionShape &a, const collisionShape &b)
+    {
+        glm::vec3 closest = closestOnSegment(b.capsule.a, b.capsule.b, a.sphere.center);
+        return testSpheres(a.sphere, {closest, b.capsule.radius});
+    }
+};
+
+template<> struct pairKernel<SHAPE_OBB, SHAPE_OBB, true>{
+    static collided test(const collisionShape &a, const collisionShape &b)
+    {
+        return testOBB(a.obb, b.obb);
+    }
+};
+
+template<> struct pairKernel<SHAPE_CAPSULE, SHAPE_CAPSULE, true>{
+    static collided test(const collisionShape &a, const collisionShape &b)
+    {
+        glm::vec3 closestA, closestB;
+        closestOnSegments(a.capsule.a, a.capsule.b, b.capsule.a, b.capsule.b, closestA, closestB);
+        return testSpheres({closestA, a.capsule.radius}, {closestB, b.capsule.radius});
+    }
+};
+
+//runs the kernel of one shape pair over a run of pairs of that kind, the loop has no dispatch in it
+template<int A, int B> inline int testPairRun(const collisionShape *shapes, const bodyPair *pairs, int pairCount, contact *contacts)
+{
+    int count = 0;
+    for(int i = 0; i < pairCount; i++)
+    {
+        int a = pairs[i].a;
+        int b = pairs[i].b;
+
+        collided result = pairKernel<A, B>::test(shapes[a], shapes[b]);
+        if(result.hasCollided)
+            contacts[count++] = {a, b, result};
+    }
+    return count;
+}
+
+//pairs where one side has no collision, nothing to test
+inline int skipPairRun(const collisionShape *, const bodyPair *, int, contact *)
+{
+    return 0;
+}
+
+typedef collided (*pairTestFunction)(const collisionShape &a, const collisionShape &b);
+typedef int (*pairRunFunction)(const collisionShape *shapes, const bodyPair *pairs, int pairCount, contact *contacts);
+
+const int PAIR_KINDS = SHAPE_COUNT * SHAPE_COUNT;
+
+template<int... KIND> constexpr std::array<pairTestFunction, PAIR_KINDS> makePairTests(std::integer_sequence<int, KIND...>)
+{
+    return {{&pairKernel<KIND / SHAPE_COUNT, KIND % SHAPE_COUNT>::test...}};
+}
+
+template<int... KIND> constexpr std::array<pairRunFunction, PAIR_KINDS + 1> makePairRuns(std::integer_sequence<int, KIND...>)
+{
+    return {{&testPairRun<KIND / SHAPE_COUNT, KIND % SHAPE_COUNT>..., &skipPairRun}};
+}
+
+//kernels indexed by typeA * SHAPE_COUNT + typeB, generated at compile time
+constexpr std::array<pairTestFunction, PAIR_KINDS> pairTests = makePairTests(std::make_integer_sequence<int, PAIR_KINDS>());
+constexpr std::array<pairRunFunction, PAIR_KINDS + 1> pairRuns = makePairRuns(std::make_integer_sequence<int, PAIR_KINDS>());
+
+//index into pairRuns, PAIR_KINDS when the pair does not collide at all
+inline int pairKind(const collisionShape &a, const collisionShape &b)
+{
+    return (a.hasCollision && b.hasCollision) ? a.type * SHAPE_COUNT + b.type : PAIR_KINDS;
+}
+
+//picks the kernel for the shape pair from the table, no allocations and no output
+inline collided testShapes(const collisionShape &a, const collisionShape &b)
+{
+    if(!a.hasCollision || !b.hasCollision)
+        return {false, 0.0f, glm::vec3(0.0f)};
+
+    return pairTests[a.type * SHAPE_COUNT + b.type](a, b);
+}
+
+/* time of impact of box a moving by motion against the box b, as a fraction of the motion.
+Slab test on the boxes, false when they do not meet during the motion or already overlap at the start */
+inline bool sweepAABB(const boundingBox &a, const glm::vec3 &motion, const boundingBox &b, float &toi, glm::vec3 &normal)
+{
+    bool flat = a.min.z == a.max.z && b.min.z == a.min.z && b.max.z == a.min.z;
+
+    float enter = 0.0f, exit = 1.0f;
+    int axis = -1;
+
+    for(int k = 0; k < 3; k++)
+    {
+        if(k == 2 && flat)
+            continue;
+
+        if(motion[k] == 0.0f)
+        {
+            if(a.max[k] <= b.min[k] || a.min[k] >= b.max[k])
+                return false;
+            continue;
+        }
+
+        float t0 = (b.min[k] - a.max[k]) / motion[k];
+        float t1 = (b.max[k] - a.min[k]) / motion[k];
+        if(t0 > t1) std::swap(t0, t1);
+
+        if(t0 > enter)
+        {
+            enter = t0;
+            axis = k;
+        }
+        exit = std::min(exit, t1);
+
+        if(enter > exit)
+            return false;
+    }
+
+    //no axis to enter through means they overlap already, the discrete contacts handle that
+    if(axis < 0)
+        return false;
+
+    toi = enter;
+    normal = glm::vec3(0.0f);
+    normal[axis] = motion[axis] > 0.0f ? 1.0f : -1.0f;
+    return true;
+}
+
+//exact time of impact of sphere a moving by motion against the sphere b
+inline bool sweepSpheres(const boundingSphere &a, const glm::vec3 &motion, const boundingSphere &b, float &toi, glm::vec3 &normal)
+{
+    glm::vec3 offset = a.center - b.center;
+    float radii = a.radius + b.radius;
+
+    float qa = glm::dot(motion, motion);
+    float qb = 2.0f * glm::dot(offset, motion);
+    float qc = glm::dot(offset, offset) - radii * radii;
+
+    if(qc < 0.0f || qa == 0.0f)
+        return false;
+
+    float discriminant = qb * qb - 4.0f * qa * qc;
+    if(discriminant < 0.0f)
+        return false;
+
+    float t = (-qb - std::sqrt(discriminant)) / (2.0f * qa);
+    if(t < 0.0f || t > 1.0f)
+        return false;
+
+    toi = t;
+    normal = glm::normalize(b.center - (a.center + motion * t));
+    return true;
+}
+
+/* sphere moving by motion against a box by conservative advancement: the sphere can get no closer than
+its distance to the box per unit of motion, so it is moved by that much until it touches.
+For flat boxes z is taken from the sphere center like in testSphereAABB() */
+inline bool sweepSphereAABB(const boundingSphere &sphere, const glm::vec3 &motion, const boundingBox &box, float &toi, glm::vec3 &normal, float tolerance = 0.01f)
+{
+    float length = glm::length(motion);
+    if(length == 0.0f)
+        return false;
+
+    bool flat = box.min.z == box.max.z;
+
+    float t = 0.0f;
+    for(int iteration = 0; iteration < 32; iteration++)
+    {
+        glm::vec3 center = sphere.center + motion * t;
+        glm::vec3 closest(std::max(box.min.x, std::min(center.x, box.max.x)),
+                          std::max(box.min.y, std::min(center.y, box.max.y)),
+                          flat ? center.z : std::max(box.min.z, std::min(center.z, box.max.z)));
+
+        float distance = glm::length(closest - center) - sphere.radius;
+        if(distance < tolerance)
+        {
+            if(t == 0.0f)
+                return false;
+
+            toi = t;
+            normal = distance > -sphere.radius ? glm::normalize(closest - center) : motion / length;
+            return true;
+        }
+
+        t += distance / length;
+        if(t > 1.0f)
+            return false;
+    }
+    return false;
+}
+
+/* time of impact of shape a moving by motion against the resting shape b, the normal points from a to b.
+Spheres sweep as spheres, every other shape as its world bounds */
+inline bool sweepShapes(const collisionShape &a, const glm::vec3 &motion, const collisionShape &b, float &toi, glm::vec3 &normal)
+{
+    if(!a.hasCollision || !b.hasCollision)
+        return false;
+
+    bool sphereA = a.type == SHAPE_SPHERE;
+    bool sphereB = b.type == SHAPE_SPHERE;
+
+    if(sphereA && sphereB)
+        return sweepSpheres(a.sphere, motion, b.sphere, toi, normal);
+    if(!sphereA && !sphereB)
+        return sweepAABB(a.box, motion, b.box, toi, normal);
+    if(sphereA)
+        return sweepSphereAABB(a.sphere, motion, b.box, toi, normal);
+
+    //a box moving onto a sphere is the sphere moving the other way
+    if(!sweepSphereAABB(b.sphere, -motion, a.box, toi, normal))
+        return false;
+    normal = -normal;
+    return true;
+}
+
+/* stable counting sort of the pairs by pairKind() into sorted, which has to hold pairCount entries.
+first[kind] is where the pairs of each kind start and first[PAIR_KINDS + 1] the end */
+inline void bucketPairs(const collisionShape *shapes, const bodyPair *pairs, int pairCount, bodyPair *sorted, int *first)
+{
+    //scratch per thread, the physics workers bucket in parallel and it only grows
+    static thread_local std::vector<unsigned char> kinds;
+    if((int)kinds.size() < pairCount)
+        kinds.resize(pairCount);
+
+    std::fill(first, first + PAIR_KINDS + 2, 0);
+    for(int i = 0; i < pairCount; i++)
+    {
+        kinds[i] = pairKind(shapes[pairs[i].a], shapes[pairs[i].b]);
+        first[kinds[i] + 1]++;
+    }
+    for(int kind = 1; kind < PAIR_KINDS + 2; kind++)
+        first[kind] += first[kind - 1];
+
+    int next[PAIR_KINDS + 1];
+    std::copy(first, first + PAIR_KINDS + 1, next);
+    for(int i = 0; i < pairCount; i++)
+        sorted[next[kinds[i]]++] = pairs[i];
+}
+
+/* tests every given pair and writes the hits into contacts, which has to hold pairCount entries.
+The pairs are bucketed by shape kinds first and every bucket goes to its kernel as one run, so mixed
+scenes make one indirect call per kind instead of one per pair. The contacts come out grouped by kind,
+callers that need the same order for any split of the pairs bucket them all up front (physicsWorld).
+Returns the number of contacts written */
+inline int testPairs(const collisionShape *shapes, const bodyPair *pairs, int pairCount, contact *contacts)
+{
+    static thread_local std::vector<bodyPair> sorted;
+    if((int)sorted.size() < pairCount)
+        sorted.resize(pairCount);
+
+    int first[PAIR_KINDS + 2];
+    bucketPairs(shapes, pairs, pairCount, sorted.data(), first);
+
+    int count = 0;
+    for(int kind = 0; kind <= PAIR_KINDS; kind++)
+    {
+        if(first[kind + 1] > first[kind])
+            count += pairRuns[kind](shapes, sorted.data() + first[kind], first[kind + 1] - first[kind], contacts + count);
+    }
+    return count;
+}
+
+struct narrowphaseBenchmarkResult{
+    double pairsPerSecond = 0.0;
+    long long pairTests = 0;
+    long long contacts = 0;
+};
+
+/* pair tests per second over random boxes and circles, about one pair in twenty touches.
+The shapes and pairs are generated up front so only the tests are timed */
+inline narrowphaseBenchmarkResult benchmarkNarrowphase(int shapeCount = 4096, int pairCount = 1 << 16, int rounds = 50)
+{
+    std::vector<collisionShape> shapes(shapeCount);
+    std::vector<bodyPair> pairs(pairCount);
+    std::vector<contact> contacts(pairCount);
+
+    srand(1);
+    for(collisionShape &shape : shapes)
+    {
+        glm::vec3 center(rand() % 1000 * 0.1f, rand() % 1000 * 0.1f, 0.0f);
+        float size = 1.0f + rand() % 100 * 0.1f;
+
+        shape.type = rand() % 4 == 0 ? SHAPE_SPHERE : SHAPE_AABB;
+        shape.hasCollision = true;
+        shape.box.min = center - glm::vec3(size, size, 0.0f);
+        shape.box.max = center + glm::vec3(size, size, 0.0f);
+        shape.sphere.center = center;
+        shape.sphere.radius = size;
+    }
+
+    for(bodyPair &pair : pairs)
+        pair = {rand() % shapeCount, rand() % shapeCount};
+
+    narrowphaseBenchmarkResult result;
+
+    auto start = std::chrono::steady_clock::now();
+    for(int round = 0; round < rounds; round++)
+        result.contacts += testPairs(shapes.data(), pairs.data(), pairCount, contacts.data());
+    auto end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    result.pairTests = (long long)pairCount * rounds;
+    result.pairsPerSecond = seconds > 0.0 ? result.pairTests / seconds : 0.0;
+    return result;
+}
+
+/* known answers for the sweeps, returns the number of cases that failed and prints each one.
+Run it after changing a sweep, the bullet sweeps and spatialQuery::sphereCast() rely on them */
+inline int checkSweeps()
+{
+    int failed = 0;
+    auto expect = [&failed](bool passed, const char *name)
+    {
+        if(!passed)
+        {
+            std::cout << "ERROR::NARROWPHASE::SWEEP_CHECK_FAILED: " << name << "\n";
+            failed++;
+        }
+    };
+
+    float toi;
+    glm::vec3 normal;
+    boundingSphere sphere = {glm::vec3(-10.0f, 0.0f, 0.0f), 1.0f};
+    glm::vec3 motion(20.0f, 0.0f, 0.0f);
+
+    //a 3D box at z 0 is hit head on and missed by a sphere passing above it in z
+    boundingBox box = {glm::vec3(-1.0f, -1.0f, -1.0f), glm::vec3(1.0f, 1.0f, 1.0f)};
+    expect(sweepSphereAABB(sphere, motion, box, toi, normal) && std::abs(toi - 0.4f) < 0.01f && normal.x > 0.99f, "sphere hits box");
+
+    boundingSphere above = {glm::vec3(-10.0f, 0.0f, 5.0f), 1.0f};
+    expect(!sweepSphereAABB(above, motion, box, toi, normal), "sphere passes over box in z");
+
+    //flat boxes take z from the sphere, like the 2D game
+    boundingBox flat = {glm::vec3(-1.0f, -1.0f, 0.0f), glm::vec3(1.0f, 1.0f, 0.0f)};
+    expect(sweepSphereAABB(above, motion, flat, toi, normal), "sphere hits flat box at any z");
+
+    //the same through sweepShapes, a box moving onto a sphere is the mirrored case
+    collisionShape moving, resting;
+    moving.type = SHAPE_AABB;
+    moving.hasCollision = resting.hasCollision = true;
+    moving.box = {glm::vec3(-11.0f, -1.0f, 4.0f), glm::vec3(-9.0f, 1.0f, 6.0f)};
+    resting.type = SHAPE_SPHERE;
+    resting.sphere = {glm::vec3(0.0f), 1.0f};
+    expect(!sweepShapes(moving, motion, resting, toi, normal), "box passes over sphere in z");
+
+    moving.box = {glm::vec3(-11.0f, -1.0f, -1.0f), glm::vec3(-9.0f, 1.0f, 1.0f)};
+    expect(sweepShapes(moving, motion, resting, toi, normal) && normal.x > 0.99f, "box hits sphere");
+
+    return failed;
+}
+
+#endif
@@ -0,0 +1,398 @@
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define OCCLUSION_SSE
+#endif
+
+#include "game.h"
+#include "jobs.h"
+
+//statistics of the last cull() call
+struct occlusionStats{
+    int occluderTriangles = 0;
+    int tested = 0;
+    int occluded = 0;
+};
+
+/* software occlusion culling. A few large occluders (terrain, big blocks) are rasterized into a low
+resolution depth buffer on the CPU, objects whose screen space bounds are behind that depth are not drawn */
+class occlusionCuller{
+    private:
+    //occluder triangle already projected to the depth buffer
+    struct screenTriangle{
+        glm::vec3 v[3];
+        int minY, maxY;
+    };
+
+    int width, height;
+    int threadCount;
+    std::vector<float> depthBuffer; // 0 is the near plane, 1 is the far plane
+
+    std::vector<glm::vec3> occluderVertices; // world space, 3 per triangle
+    std::vector<gameObject*> occluderObjects; // never tested, they occlude themselves
+    std::vector<screenTriangle> screenTriangles;
+
+    std::vector<gameObject*> visibleObjects;
+    glm::mat4 viewProjection;
+    occlusionStats stats;
+
+    void addTriangle(glm::vec3 a, glm::vec3 b, glm::vec3 c)
+    {
+        occluderVertices.push_back(a);
+        occluderVertices.push_back(b);
+        occluderVertices.push_back(c);
+    }
+
+    //projects a point to (pixel x, pixel y, depth), returns false if it is behind the near plane
+    bool project(glm::vec3 point, glm::vec3 &screen)
+    {
+        glm::vec4 clip = viewProjection * glm::vec4(point, 1.0f);
+        if(clip.w < 1e-4f)
+            return false;
+
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        screen.x = (ndc.x * 0.5f + 0.5f) * width;
+        screen.y = (ndc.y * 0.5f + 0.5f) * height;
+        screen.z = ndc.z * 0.5f + 0.5f;
+        return true;
+    }
+
+    void setupTriangles()
+    {
+        screenTriangles.clear();
+
+        for(int i = 0, s = occluderVertices.size(); i + 2 < s; i += 3)
+        {
+            screenTriangle tri;
+
+            //triangles crossing the near plane are dropped, which only makes the occluder smaller
+            if(!project(occluderVertices[i], tri.v[0]) || !project(occluderVertices[i + 1], tri.v[1]) || !project(occluderVertices[i + 2], tri.v[2]))
+                continue;
+
+            float area = (tri.v[1].x - tri.v[0].x) * (tri.v[2].y - tri.v[0].y) - (tri.v[1].y - tri.v[0].y) * (tri.v[2].x - tri.v[0].x);
+            if(area == 0.0f)
+                continue;
+
+            //occluders are double sided, flip to counter clockwise
+            if(area < 0.0f)
+                std::swap(tri.v[1], tri.v[2]);
+
+            float minY = std::min(tri.v[0].y, std::min(tri.v[1].y, tri.v[2].y));
+            float maxY = std::max(tri.v[0].y, std::max(tri.v[1].y, tri.v[2].y));
+            float minX = std::min(tri.v[0].x, std::min(tri.v[1].x, tri.v[2].x));
+            float maxX = std::max(tri.v[0].x, std::max(tri.v[1].x, tri.v[2].x));
+
+            if(maxX < 0 || minX >= width || maxY < 0 || minY >= height)
+                continue;
+
+            tri.minY = std::max(0, (int)minY);
+            tri.maxY = std::min(height - 1, (int)maxY);
+            screenTriangles.push_back(tri);
+        }
+    }
+
+    //rasterizes every triangle into the rows [rowStart, rowEnd), each worker owns one band of rows
+    void rasterizeBand(int rowStart, int rowEnd)
+    {
+        for(const screenTriangle &tri : screenTriangles)
+        {
+            if(tri.maxY < rowStart || tri.minY >= rowEnd)
+                continue;
+
+            const glm::vec3 &v0 = tri.v[0];
+            const glm::vec3 &v1 = tri.v[1];
+            const glm::vec3 &v2 = tri.v[2];
+
+            int minX = std::max(0, (int)std::min(v0.x, std::min(v1.x, v2.x)));
+            int maxX = std::min(width - 1, (int)std::max(v0.x, std::max(v1.x, v2.x)));
+            int minY = std::max(rowStart, tri.minY);
+            int maxY = std::min(rowEnd - 1, tri.maxY);
+
+            float invArea = 1.0f / ((v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x));
+
+            //edge functions e(p) = a * p.x + b * p.y + c, one per edge
+            float a0 = v1.y - v2.y, b0 = v2.x - v1.x, c0 = v1.x * v2.y - v1.y * v2.x;
+            float a1 = v2.y - v0.y, b1 = v0.x - v2.x, c1 = v2.x * v0.y - v2.y * v0.x;
+            float a2 = v0.y - v1.y, b2 = v1.x - v0.x, c2 = v0.x * v1.y - v0.y * v1.x;
+
+            for(int y = minY; y <= maxY; y++)
+            {
+                float py = y + 0.5f;
+                float *row = &depthBuffer[y * width];
+
+#ifdef OCCLUSION_SSE
+                int startX = minX & ~3;
+                __m128 px = _mm_add_ps(_mm_set1_ps(startX + 0.5f), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f));
+                __m128 w0 = _mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(a0)), _mm_set1_ps(b0 * py + c0));
+                __m128 w1 = _mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(a1)), _mm_set1_ps(b1 * py + c1));
+                __m128 w2 = _mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(a2)), _mm_set1_ps(b2 * py + c2));
+                __m128 step0 = _mm_set1_ps(4.0f * a0);
+                __m128 step1 = _mm_set1_ps(4.0f * a1);
+                __m128 step2 = _mm_set1_ps(4.0f * a2);
+                __m128 zero = _mm_setzero_ps();
+
+                for(int x = startX; x <= maxX; x += 4)
+                {
+                    __m128 inside = _mm_and_ps(_mm_cmpge_ps(w0, zero), _mm_and_ps(_mm_cmpge_ps(w1, zero), _mm_cmpge_ps(w2, zero)));
+
+                    if(_mm_movemask_ps(inside))
+                    {
+                        __m128 z = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(w0, _mm_set1_ps(v0.z)), _mm_mul_ps(w1, _mm_set1_ps(v1.z))), _mm_mul_ps(w2, _mm_set1_ps(v2.z))), _mm_set1_ps(invArea));
+                        __m128 old = _mm_loadu_ps(row + x);
+                        __m128 result = _mm_or_ps(_mm_and_ps(inside, _mm_min_ps(old, z)), _mm_andnot_ps(inside, old));
+                        _mm_storeu_ps(row + x, result);
+                    }
+
+                    w0 = _mm_add_ps(w0, step0);
+                    w1 = _mm_add_ps(w1, step1);
+                    w2 = _mm_add_ps(w2, step2);
+                }
+#else
+                for(int x = minX; x <= maxX; x++)
+                {
+                    float px = x + 0.5f;
+                    float w0 = a0 * px + b0 * py + c0;
+                    float w1 = a1 * px + b1 * py + c1;
+                    float w2 = a2 * px + b2 * py + c2;
+
+                    if(w0 < 0 || w1 < 0 || w2 < 0)
+                        continue;
+
+                    float z = (w0 * v0.z + w1 * v1.z + w2 * v2.z) * invArea;
+                    row[x] = std::min(row[x], z);
+                }
+#endif
+            }
+        }
+    }
+
+    //true if any pixel under the rectangle is farther away than depth
+    bool testRect(int minX, int maxX, int minY, int maxY, float depth)
+    {
+        for(int y = minY; y <= maxY; y++)
+        {
+            const float *row = &depthBuffer[y * width];
+
+#ifdef OCCLUSION_SSE
+            int startX = minX & ~3;
+            __m128 objectDepth = _mm_set1_ps(depth);
+            __m128 first = _mm_set1_ps((float)minX);
+            __m128 last = _mm_set1_ps((float)maxX);
+            __m128 px = _mm_add_ps(_mm_set1_ps((float)startX), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f));
+
+            for(int x = startX; x <= maxX; x += 4)
+            {
+                __m128 inRect = _mm_and_ps(_mm_cmpge_ps(px, first), _mm_cmple_ps(px, last));
+                __m128 farther = _mm_cmpge_ps(_mm_loadu_ps(row + x), objectDepth);
+
+                if(_mm_movemask_ps(_mm_and_ps(inRect, farther)))
+                    return true;
+
+                px = _mm_add_ps(px, _mm_set1_ps(4.0f));
+            }
+#else
+            for(int x = minX; x <= maxX; x++)
+            {
+                if(row[x] >= depth)
+                    return true;
+            }
+#endif
+        }
+        return false;
+    }
+
+    public:
+    //width is rounded up to a multiple of 4 so rows can be processed 4 pixels at a time
+    occlusionCuller(int width = 256, int height = 128, int threadCount = 0)
+    {
+        this->width = (width + 3) & ~3;
+        this->height = height;
+
+        if(threadCount <= 0)
+            threadCount = std::max(1u, std::min(8u, std::thread::hardware_concurrency()));
+        this->threadCount = threadCount;
+
+        depthBuffer.resize(this->width * this->height, 1.0f);
+        viewProjection = glm::mat4(1.0f);
+    }
+
+    //occluder from the 8 corners of an object's mesh bounds, meant for big solid blocks
+    void addBlockOccluder(gameObject *objPtr)
+    {
+        boundingBox box = objPtr->getLocalBounds();
+        glm::mat4 world = objPtr->getWorldMatrix();
+
+        glm::vec3 c[8];
+        for(int i = 0; i < 8; i++)
+        {
+            glm::vec3 corner((i & 1) ? box.max.x : box.min.x, (i & 2) ? box.max.y : box.min.y, (i & 4) ? box.max.z : box.min.z);
+            c[i] = glm::vec3(world * glm::vec4(corner, 1.0f));
+        }
+
+        int faces[12][3] = {
+            {0, 1, 3}, {0, 3, 2}, {4, 6, 7}, {4, 7, 5},
+            {0, 4, 5}, {0, 5, 1}, {2, 3, 7}, {2, 7, 6},
+            {0, 2, 6}, {0, 6, 4}, {1, 5, 7}, {1, 7, 3}
+        };
+
+        for(int i = 0; i < 12; i++)
+            addTriangle(c[faces[i][0]], c[faces[i][1]], c[faces[i][2]]);
+
+        occluderObjects.push_back(objPtr);
+    }
+
+    /* simplified occluder for meshes made by sheet3D (terrain, water). Only every step-th grid vertex is used
+    and each one takes the lowest height around it, so the simplified surface never sticks out of the real one */
+    void addTerrainOccluder(gameObject *objPtr, int step = 8)
+    {
+        const std::vector<float> &verts = objPtr->getVertices();
+        int parts = objPtr->getGridSize();
+        glm::mat4 world = objPtr->getWorldMatrix();
+
+        if(parts < 2 || (int)verts.size() < 3 * parts * parts)
+            return;
+
+        step = std::max(1, std::min(step, parts - 1));
+
+        std::vector<int> samples;
+        for(int i = 0; i < parts - 1; i += step)
+            samples.push_back(i);
+        samples.push_back(parts - 1);
+
+        int count = samples.size();
+        std::vector<glm::vec3> coarse(count * count);
+
+        for(int r = 0; r < count; r++)
+        {
+            for(int c = 0; c < count; c++)
+            {
+                int row = samples[r];
+                int colm = samples[c];
+
+                float lowest = verts[3 * (row * parts + colm) + 2];
+                for(int i = std::max(0, row - step); i <= std::min(parts - 1, row + step); i++)
+                {
+                    for(int j = std::max(0, colm - step); j <= std::min(parts - 1, colm + step); j++)
+                        lowest = std::min(lowest, verts[3 * (i * parts + j) + 2]);
+                }
+
+                glm::vec4 point(verts[3 * (row * parts + colm) + 0], verts[3 * (row * parts + colm) + 1], lowest, 1.0f);
+                coarse[r * count + c] = glm::vec3(world * point);
+            }
+        }
+
+        for(int r = 0; r < count - 1; r++)
+        {
+            for(int c = 0; c < count - 1; c++)
+            {
+                addTriangle(coarse[r * count + c], coarse[r * count + c + 1], coarse[(r + 1) * count + c]);
+                addTriangle(coarse[(r + 1) * count + c], coarse[r * count + c + 1], coarse[(r + 1) * count + c + 1]);
+            }
+        }
+
+        occluderObjects.push_back(objPtr);
+    }
+
+    void clearOccluders()
+    {
+        occluderVertices.clear();
+        occluderObjects.clear();
+    }
+
+    //clears and fills the depth buffer with the occluders, the rows are split between the worker threads
+    void render(const glm::mat4 &viewProjection = projection * view)
+    {
+        this->viewProjection = viewProjection;
+        std::fill(depthBuffer.begin(), depthBuffer.end(), 1.0f);
+
+        setupTriangles();
+        stats.occluderTriangles = screenTriangles.size();
+
+        engineJobs().parallelRanges(height, 1, threadCount, [this](int, int first, int last){
+            rasterizeBand(first, last);
+        });
+    }
+
+    //true if some part of the box might be in front of the occluders
+    bool isVisible(const boundingBox &box)
+    {
+        float minX = width, maxX = -1, minY = height, maxY = -1;
+        float nearest = 1.0f;
+
+        for(int i = 0; i < 8; i++)
+        {
+            glm::vec3 corner((i & 1) ? box.max.x : box.min.x, (i & 2) ? box.max.y : box.min.y, (i & 4) ? box.max.z : box.min.z);
+            glm::vec3 screen;
+
+            //the box crosses the near plane, the camera might be inside of it
+            if(!project(corner, screen))
+                return true;
+
+            minX = std::min(minX, screen.x);
+            maxX = std::max(maxX, screen.x);
+            minY = std::min(minY, screen.y);
+            maxY = std::max(maxY, screen.y);
+            nearest = std::min(nearest, screen.z);
+        }
+
+        int x0 = std::max(0, (int)minX);
+        int x1 = std::min(width - 1, (int)maxX);
+        int y0 = std::max(0, (int)minY);
+        int y1 = std::min(height - 1, (int)maxY);
+
+        //outside the screen, the frustum culling decides about those
+        if(x0 > x1 || y0 > y1)
+            return true;
+
+        return testRect(x0, x1, y0, y1, nearest);
+    }
+
+    //returns the objects from the list that are not hidden behind the occluders, call render() first
+    const std::vector<gameObject*> &cull(const std::vector<gameObject*> &objects)
+    {
+        visibleObjects.clear();
+        stats.tested = 0;
+
+        for(gameObject *objPtr : objects)
+        {
+            if(std::find(occluderObjects.begin(), occluderObjects.end(), objPtr) != occluderObjects.end())
+            {
+                visibleObjects.push_back(objPtr);
+                continue;
+            }
+
+            stats.tested++;
+            if(isVisible(objPtr->getWorldBounds()))
+                visibleObjects.push_back(objPtr);
+        }
+
+        stats.occluded = objects.size() - visibleObjects.size();
+        return visibleObjects;
+    }
+
+    void drawVisible(light lightSource, glm::vec3 cameraPos)
+    {
+        for(gameObject *objPtr : visibleObjects)
+            objPtr->draw(lightSource, cameraPos);
+    }
+
+    occlusionStats getStats()
+    {
+        return stats;
+    }
+
+    const std::vector<float> &getDepthBuffer()
+    {
+        return depthBuffer;
+    }
+};
+
+#endif
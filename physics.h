@@ -0,0 +1,1236 @@
+#ifndef PHYSICS_H
+#define PHYSICS_H
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <chrono>
+
+#include <glm/glm.hpp>
+
+#include "game.h"
+#include "timestep.h"
+#include "contactsolver.h"
+#include "culling.h"
+#include "jobs.h"
+
+enum broadphaseMode { sweepAndPrune, spatialHash };
+
+//simulation detail of a body, picked every step from its distance to the LOD focus
+enum physicsLOD { LOD_NEAR, LOD_FAR, LOD_FROZEN };
+
+/* owns the simulation step of a set of gameObjects. The broadphase finds the pairs whose world bounds
+overlap and only those reach the narrowphase, instead of testing every pair. Contacts are first
+generated for all pairs on the worker threads and then solved by the contactSolver in coloured
+batches, a batch never touches the same moving body twice so its contacts are solved in parallel.
+Bodies that stay slow for a while fall asleep together with everything they touch (their island), sleeping
+bodies are not moved and their pairs with other resting bodies never reach the narrowphase.
+Bullet bodies are additionally swept along their motion and stopped at the first time of impact.
+With physics LOD on, far bodies only tick every few steps and frozen ones not at all, see setLOD().
+Sweep and prune keeps the objects sorted along x between steps, which suits the mostly 1D side scroller.
+The spatial hash buckets the bounds into a uniform grid, which suits 3D scenes */
+class physicsWorld{
+    private:
+    struct interval{
+        float min, max;
+        int index;
+    };
+
+    struct cellEntry{
+        int x, y, z;
+        int index;
+    };
+
+    //start of a snapshot, the counts give the layout of the rest of the block
+    struct snapshotHeader{
+        int bodyCount;
+        int objectCount;
+        int cacheCount; // warm start impulses
+        int axisCount; // sweep order, 0 when it has to be rebuilt anyway
+        int nextIsland;
+        int lodCount; // LOD tiers and frozen times, 0 before the first step
+        unsigned int stepCount;
+    };
+
+    //first thing a bullet hits during this step
+    struct sweepHit{
+        int object, target;
+        float toi;
+        glm::vec3 normal; // from the bullet to the target
+        glm::vec3 start, motion;
+    };
+
+    std::vector<gameObject*> objects;
+    bodyStorage bodies; // the bodies of all objects, packed so step() integrates them in one pass
+    std::vector<boundingBox> boxes;
+    std::vector<char> active; // takes part in collisions this step
+    std::vector<bodyPair> pairs;
+    std::vector<bodyPair> sortedPairs; // scratch for bucketing the pairs by shape kinds
+    std::vector<char> staticBodies;
+    std::vector<char> restingBodies; // static or asleep, a pair of two resting bodies is skipped
+    std::vector<collisionShape> shapes; // world space colliders of this step, kept for sleeping objects
+    bool shapesDirty = true;
+    std::vector<contact> contacts;
+    std::vector<sweepHit> sweepHits;
+    std::vector<int> farHits; // sweep hit of each far body this step, -1 without one
+
+    int threadCount;
+    std::vector<std::vector<contact>> workerContacts; // per worker narrowphase output, merged in order
+
+    //contact graph colouring, colours past the mask size go into one last batch solved on a single thread
+    static const int maxColours = 64;
+    std::vector<uint64_t> bodyColours; // colours already used by the contacts of each body
+    std::vector<int> contactColours;
+    std::vector<int> solveOrder; // contact indices sorted by colour
+    std::vector<int> batchStart; // first entry of each colour in solveOrder, plus the end
+    std::vector<int> batchFill;
+
+    contactSolver solver;
+
+    //sleeping, the island of a sleeping object is the id it fell asleep with, -1 while awake
+    std::vector<int> sleepIsland;
+    std::vector<int> islandParent; // union find over the contacts of one step
+    std::vector<float> islandTimer; // shortest sleep timer of each island root
+    std::vector<int> islandId; // id handed to each root that falls asleep this step
+    int nextIsland = 0;
+    bool sleepEnabled = true;
+    float sleepVelocity = 1.0f;
+    float timeToSleep = 0.5f;
+
+    //physics LOD, per object like sleepIsland
+    std::vector<char> lodTier;
+    std::vector<float> lodScale; // time scale of the body this step, 0 when it does not move
+    std::vector<char> lodMoved; // moved last step, its shape has to be taken again
+    std::vector<float> frozenTime; // step time a frozen body missed
+    float lodStepTime = 0.0f;
+    bool lodEnabled = false;
+    float lodNear = 0.0f, lodFar = 0.0f;
+    int farDivider = 4;
+    bool freezeOffscreen = false;
+    float offscreenMargin = 0.0f;
+    glm::vec3 lodPoint = glm::vec3(0.0f);
+    gameObject *lodObject = NULL;
+    unsigned int stepCount = 0;
+
+    broadphaseMode mode;
+    float cellSize;
+
+    //sweep and prune state, stays almost sorted between steps
+    std::vector<interval> axisList;
+    bool listDirty = true;
+
+    //spatial hash state
+    std::vector<cellEntry> cells;
+
+    static bool overlaps(const boundingBox &a, const boundingBox &b)
+    {
+        return a.min.x <= b.max.x && a.max.x >= b.min.x &&
+               a.min.y <= b.max.y && a.max.y >= b.min.y &&
+               a.min.z <= b.max.z && a.max.z >= b.min.z;
+    }
+
+    void addPair(int a, int b)
+    {
+        //two static or sleeping bodies never need resolving
+        if(restingBodies[a] && restingBodies[b])
+            return;
+
+        //bodies away from the focus only collide with the level and the near bodies
+        if(lodTier[a] != LOD_NEAR && lodTier[b] != LOD_NEAR && !staticBodies[a] && !staticBodies[b])
+            return;
+
+        if(a > b) std::swap(a, b);
+        pairs.push_back({a, b});
+    }
+
+    void sweepPairs()
+    {
+        if(listDirty)
+        {
+            axisList.resize(objects.size());
+            for(int i = 0, s = objects.size(); i < s; i++)
+                axisList[i].index = i;
+            listDirty = false;
+        }
+
+        for(interval &entry : axisList)
+        {
+            entry.min = boxes[entry.index].min.x;
+            entry.max = boxes[entry.index].max.x;
+        }
+
+        //insertion sort, objects barely move between steps so this is close to linear
+        for(int i = 1, s = axisList.size(); i < s; i++)
+        {
+            interval entry = axisList[i];
+            int j = i - 1;
+            while(j >= 0 && axisList[j].min > entry.min)
+            {
+                axisList[j + 1] = axisList[j];
+                j--;
+            }
+            axisList[j + 1] = entry;
+        }
+
+        for(int i = 0, s = axisList.size(); i < s; i++)
+        {
+            if(!active[axisList[i].index]) continue;
+
+            for(int j = i + 1; j < s && axisList[j].min <= axisList[i].max; j++)
+            {
+                int a = axisList[i].index;
+                int b = axisList[j].index;
+
+                if(active[b] && overlaps(boxes[a], boxes[b]))
+                    addPair(a, b);
+            }
+        }
+    }
+
+    void hashPairs()
+    {
+        cells.clear();
+
+        for(int i = 0, s = objects.size(); i < s; i++)
+        {
+            if(!active[i]) continue;
+
+            glm::vec3 first = glm::floor(boxes[i].min / cellSize);
+            glm::vec3 last = glm::floor(boxes[i].max / cellSize);
+
+            for(int x = (int)first.x; x <= (int)last.x; x++)
+                for(int y = (int)first.y; y <= (int)last.y; y++)
+                    for(int z = (int)first.z; z <= (int)last.z; z++)
+                        cells.push_back({x, y, z, i});
+        }
+
+        //sorting groups the entries of each cell together, no hash map needed
+        std::sort(cells.begin(), cells.end(), [](const cellEntry &l, const cellEntry &r){
+            if(l.x != r.x) return l.x < r.x;
+            if(l.y != r.y) return l.y < r.y;
+            if(l.z != r.z) return l.z < r.z;
+            return l.index < r.index;
+        });
+
+        for(int start = 0, s = cells.size(); start < s;)
+        {
+            int end = start + 1;
+            while(end < s && cells[end].x == cells[start].x && cells[end].y == cells[start].y && cells[end].z == cells[start].z)
+                end++;
+
+            for(int i = start; i < end; i++)
+            {
+                for(int j = i + 1; j < end; j++)
+                {
+                    int a = cells[i].index;
+                    int b = cells[j].index;
+
+                    if(!overlaps(boxes[a], boxes[b]))
+                        continue;
+
+                    //objects sharing several cells are only reported from the first cell of their overlap
+                    glm::vec3 overlapMin = glm::floor(glm::max(boxes[a].min, boxes[b].min) / cellSize);
+                    if((int)overlapMin.x == cells[i].x && (int)overlapMin.y == cells[i].y && (int)overlapMin.z == cells[i].z)
+                        addPair(a, b);
+                }
+            }
+            start = end;
+        }
+    }
+
+    /* calls work(worker, first, last) for one slice of [0, count) per worker on the engine job system, small
+    counts stay on this thread. Returns the number of workers used */
+    template<typename F>
+    int parallelRanges(int count, int minPerWorker, F work)
+    {
+        return engineJobs().parallelRanges(count, minPerWorker, threadCount, work);
+    }
+
+    /* tests the pairs on the workers. The pairs are bucketed by shape kinds for the whole step first, so every
+    worker gets runs of one kind and merging in worker order gives the same contact order for any thread count */
+    void generateContacts()
+    {
+        workerContacts.resize(threadCount);
+
+        int first[PAIR_KINDS + 2];
+        sortedPairs.resize(pairs.size());
+        bucketPairs(shapes.data(), pairs.data(), pairs.size(), sortedPairs.data(), first);
+        pairs.swap(sortedPairs);
+
+        int workers = parallelRanges(pairs.size(), 256, [this](int worker, int first, int last){
+            std::vector<contact> &buffer = workerContacts[worker];
+            buffer.resize(last - first);
+            buffer.resize(testPairs(shapes.data(), pairs.data() + first, last - first, buffer.data()));
+        });
+
+        contacts.clear();
+        for(int i = 0; i < workers; i++)
+            contacts.insert(contacts.end(), workerContacts[i].begin(), workerContacts[i].end());
+    }
+
+    //greedy colouring in contact order, static bodies are never written so they do not take a colour
+    void colourContacts()
+    {
+        int contactCount = contacts.size();
+        bodyColours.assign(objects.size(), 0);
+        contactColours.resize(contactCount);
+        batchStart.assign(maxColours + 2, 0);
+
+        for(int i = 0; i < contactCount; i++)
+        {
+            int a = contacts[i].a;
+            int b = contacts[i].b;
+
+            uint64_t used = (staticBodies[a] ? 0 : bodyColours[a]) | (staticBodies[b] ? 0 : bodyColours[b]);
+
+            int colour = 0;
+            while(colour < maxColours && ((used >> colour) & 1))
+                colour++;
+
+            if(colour < maxColours)
+            {
+                if(!staticBodies[a]) bodyColours[a] |= (uint64_t)1 << colour;
+                if(!staticBodies[b]) bodyColours[b] |= (uint64_t)1 << colour;
+            }
+
+            contactColours[i] = colour;
+            batchStart[colour + 1]++;
+        }
+
+        //counting sort, contacts keep their order inside a batch
+        for(int colour = 0; colour <= maxColours; colour++)
+            batchStart[colour + 1] += batchStart[colour];
+
+        solveOrder.resize(contactCount);
+        batchFill.assign(batchStart.begin(), batchStart.end());
+        for(int i = 0; i < contactCount; i++)
+            solveOrder[batchFill[contactColours[i]]++] = i;
+    }
+
+    //calls work(worker, first, last) over the solve order of every colour batch, one batch after the other
+    template<typename F>
+    void forEachBatch(F work)
+    {
+        for(int colour = 0; colour <= maxColours; colour++)
+        {
+            int first = batchStart[colour];
+            int last = batchStart[colour + 1];
+            if(first == last)
+                continue;
+
+            //the overflow batch can share bodies between contacts
+            if(colour == maxColours)
+                work(0, first, last);
+            else
+                parallelRanges(last - first, 64, [&work, first](int worker, int begin, int end){
+                    work(worker, first + begin, first + end);
+                });
+        }
+    }
+
+    void solveContacts(float deltaTime)
+    {
+        colourContacts();
+        solver.prepare(contacts, objects, bodies, deltaTime);
+
+        const int *order = solveOrder.data();
+        forEachBatch([this, order](int, int first, int last){
+            solver.warmStart(bodies, order, first, last);
+        });
+
+        for(int i = 0; i < solver.getIterations(); i++)
+        {
+            forEachBatch([this, order](int, int first, int last){
+                solver.solve(bodies, order, first, last);
+            });
+        }
+
+        solver.store();
+        solver.updateGroundContacts(contacts, objects);
+    }
+
+    /* sweeps every awake bullet with its solved velocity against all other colliders, moving targets are
+    handled with the relative motion. Bullets are expected to be few, so the candidates are a plain loop
+    over the bounds instead of a broadphase query */
+    void sweepBullets(float deltaTime)
+    {
+        sweepHits.clear();
+
+        for(int i = 0, s = objects.size(); i < s; i++)
+        {
+            if(restingBodies[i] || !active[i])
+                continue;
+
+            int index = bodies.indexOf(objects[i]->getBody());
+            if(!(bodies.flags[index] & BODY_BULLET))
+                continue;
+
+            glm::vec3 motion = glm::vec3(bodies.velocityX[index], bodies.velocityY[index], bodies.velocityZ[index]) * deltaTime * bodies.timeScale[index];
+            if(motion == glm::vec3(0.0f))
+                continue;
+
+            sweepHit hit = {i, -1, 1.0f, glm::vec3(0.0f), bodies.getPosition(objects[i]->getBody()), motion};
+
+            for(int j = 0; j < s; j++)
+            {
+                if(j == i || !active[j])
+                    continue;
+
+                glm::vec3 relative = motion;
+                if(!restingBodies[j])
+                    relative -= objects[j]->getVelocity() * deltaTime;
+
+                //bounds of the whole relative motion against the target bounds
+                boundingBox swept = boxes[i];
+                swept.min = glm::min(swept.min, swept.min + relative);
+                swept.max = glm::max(swept.max, swept.max + relative);
+                if(!overlaps(swept, boxes[j]))
+                    continue;
+
+                float toi;
+                glm::vec3 normal;
+                if(sweepShapes(shapes[i], relative, shapes[j], toi, normal) && toi < hit.toi)
+                {
+                    hit.target = j;
+                    hit.toi = toi;
+                    hit.normal = normal;
+                }
+            }
+
+            if(hit.target >= 0)
+                sweepHits.push_back(hit);
+        }
+
+        if(lodEnabled)
+            sweepFarBodies(deltaTime);
+    }
+
+    /* a far body moves farDivider steps at once, which is enough to pass through the level. Its bounds were
+    stretched over the motion in findPairs(), so it only has to be swept against the static bodies it pairs with */
+    void sweepFarBodies(float deltaTime)
+    {
+        farHits.assign(objects.size(), -1);
+
+        for(const bodyPair &pair : pairs)
+        {
+            int i = pair.a, j = pair.b;
+            if(!staticBodies[j])
+                std::swap(i, j);
+
+            if(!staticBodies[j] || lodTier[i] != LOD_FAR || lodScale[i] == 0.0f || !active[i] || !active[j])
+                continue;
+
+            int index = bodies.indexOf(objects[i]->getBody());
+            if(bodies.flags[index] & BODY_BULLET)
+                continue;
+
+            glm::vec3 motion = glm::vec3(bodies.velocityX[index], bodies.velocityY[index], bodies.velocityZ[index]) * deltaTime * lodScale[i];
+
+            float toi;
+            glm::vec3 normal;
+            if(motion == glm::vec3(0.0f) || !sweepShapes(shapes[i], motion, shapes[j], toi, normal))
+                continue;
+
+            if(farHits[i] < 0)
+            {
+                farHits[i] = sweepHits.size();
+                sweepHits.push_back({i, j, toi, normal, bodies.getPosition(objects[i]->getBody()), motion});
+            }
+            else if(toi < sweepHits[farHits[i]].toi)
+                sweepHits[farHits[i]] = {i, j, toi, normal, sweepHits[farHits[i]].start, motion};
+        }
+    }
+
+    //puts the bullets at their time of impact and takes away the velocity into the target
+    void applySweepHits()
+    {
+        for(const sweepHit &hit : sweepHits)
+        {
+            gameObject *bullet = objects[hit.object];
+            gameObject *target = objects[hit.target];
+            bodyHandle handle = bullet->getBody();
+
+            bodies.setPosition(handle, hit.start + hit.motion * hit.toi);
+
+            glm::vec3 velocity = bodies.getVelocity(handle);
+            float approach = glm::dot(velocity, hit.normal);
+            if(approach > 0.0f)
+            {
+                float e = std::min(bullet->getRestitution(), target->getRestitution());
+                velocity -= (1.0f + e) * approach * hit.normal;
+                bodies.setVelocity(handle, velocity);
+            }
+
+            //same ground rule as the contact solver
+            if(staticBodies[hit.target] && hit.normal.y < -0.5f && std::abs(velocity.y) < 0.1f)
+                bodies.setFlag(handle, BODY_ON_GROUND, true);
+        }
+    }
+
+    int findIsland(int i)
+    {
+        while(islandParent[i] != i)
+        {
+            islandParent[i] = islandParent[islandParent[i]];
+            i = islandParent[i];
+        }
+        return i;
+    }
+
+    void wakeIsland(int island)
+    {
+        for(int i = 0, s = objects.size(); i < s; i++)
+        {
+            if(sleepIsland[i] != island)
+                continue;
+
+            objects[i]->wake();
+            sleepIsland[i] = -1;
+            restingBodies[i] = staticBodies[i];
+        }
+    }
+
+    //an awake body touching a sleeping one wakes its whole island before the contacts are solved
+    void wakeTouchedIslands()
+    {
+        for(const contact &c : contacts)
+        {
+            if(sleepIsland[c.a] >= 0 && !restingBodies[c.b])
+                wakeIsland(sleepIsland[c.a]);
+            else if(sleepIsland[c.b] >= 0 && !restingBodies[c.a])
+                wakeIsland(sleepIsland[c.b]);
+        }
+    }
+
+    /* joins the moving bodies of every contact into islands, an island falls asleep once all of its
+    bodies have been slower than sleepVelocity for timeToSleep. Static bodies do not join islands,
+    otherwise everything standing on the same ground would be one island */
+    void updateSleep(float deltaTime)
+    {
+        int size = objects.size();
+        islandParent.resize(size);
+        islandTimer.assign(size, 1e30f);
+        islandId.assign(size, -1);
+
+        for(int i = 0; i < size; i++)
+        {
+            islandParent[i] = i;
+            if(restingBodies[i])
+                continue;
+
+            int index = bodies.indexOf(objects[i]->getBody());
+            glm::vec3 velocity(bodies.velocityX[index], bodies.velocityY[index], bodies.velocityZ[index]);
+
+            if(glm::dot(velocity, velocity) > sleepVelocity * sleepVelocity)
+                bodies.sleepTimer[index] = 0.0f;
+            else
+                bodies.sleepTimer[index] += deltaTime;
+        }
+
+        for(const contact &c : contacts)
+        {
+            if(restingBodies[c.a] || restingBodies[c.b])
+                continue;
+
+            int rootA = findIsland(c.a);
+            int rootB = findIsland(c.b);
+            if(rootA != rootB)
+                islandParent[std::max(rootA, rootB)] = std::min(rootA, rootB);
+        }
+
+        for(int i = 0; i < size; i++)
+        {
+            if(restingBodies[i])
+                continue;
+
+            int root = findIsland(i);
+            islandTimer[root] = std::min(islandTimer[root], bodies.sleepTimer[bodies.indexOf(objects[i]->getBody())]);
+        }
+
+        for(int i = 0; i < size; i++)
+        {
+            if(restingBodies[i])
+                continue;
+
+            int root = findIsland(i);
+            if(islandTimer[root] < timeToSleep)
+                continue;
+
+            if(islandId[root] < 0)
+                islandId[root] = nextIsland++;
+
+            bodies.sleep(objects[i]->getBody());
+            sleepIsland[i] = islandId[root];
+            restingBodies[i] = true;
+
+            //the shape it keeps while asleep is taken next step, after the last correction moved it
+            shapesDirty = true;
+        }
+    }
+
+    //catches a frozen body up with the time it missed, bodies that collide resume where they stopped
+    void thaw(int i, int index)
+    {
+        float time = frozenTime[i];
+        frozenTime[i] = 0.0f;
+
+        int flags = bodies.flags[index];
+        if(time <= 0.0f || (flags & (BODY_COLLISION | BODY_SLEEPING)))
+            return;
+
+        glm::vec3 velocity(bodies.velocityX[index], bodies.velocityY[index], bodies.velocityZ[index]);
+        glm::vec3 acceleration(0.0f);
+        if((flags & BODY_GRAVITY) && !(flags & BODY_ON_GROUND))
+            acceleration = glm::vec3(bodies.accelerationX[index], bodies.accelerationY[index], bodies.accelerationZ[index]);
+
+        glm::vec3 move = velocity * time + 0.5f * acceleration * time * time;
+        velocity += acceleration * time;
+
+        bodies.positionX[index] += move.x;
+        bodies.positionY[index] += move.y;
+        bodies.positionZ[index] += move.z;
+        bodies.velocityX[index] = velocity.x;
+        bodies.velocityY[index] = velocity.y;
+        bodies.velocityZ[index] = velocity.z;
+
+        //no interpolation across the jump
+        bodies.previousX[index] = bodies.positionX[index];
+        bodies.previousY[index] = bodies.positionY[index];
+        bodies.previousZ[index] = bodies.positionZ[index];
+    }
+
+    /* picks the LOD tier of every body from its distance to the focus and sets the time scale of its body.
+    Far bodies tick on one step in farDivider with farDivider times the step time, spread over the steps by
+    their index so the cost is even. Frozen bodies do not move at all */
+    void updateLOD(float deltaTime)
+    {
+        int size = objects.size();
+        lodTier.resize(size, LOD_NEAR);
+        lodScale.resize(size, 1.0f);
+        lodMoved.resize(size, 1);
+        frozenTime.resize(size, 0.0f);
+        lodStepTime = deltaTime;
+        stepCount++;
+
+        glm::vec3 focus = lodObject != NULL ? lodObject->getPosition() : lodPoint;
+
+        frustum screen;
+        if(lodEnabled && freezeOffscreen)
+            screen.extract(projection * view);
+
+        for(int i = 0; i < size; i++)
+        {
+            int index = bodies.indexOf(objects[i]->getBody());
+            int tier = LOD_NEAR;
+
+            if(lodEnabled && !objects[i]->getStaticStatus() && objects[i] != lodObject)
+            {
+                glm::vec3 position(bodies.positionX[index], bodies.positionY[index], bodies.positionZ[index]);
+                float distance = glm::length(position - focus);
+
+                if(distance >= lodFar)
+                    tier = LOD_FROZEN;
+                else if(distance >= lodNear)
+                    tier = LOD_FAR;
+
+                if(tier != LOD_FROZEN && freezeOffscreen)
+                {
+                    boundingSphere sphere = objects[i]->getBoundingSphere();
+                    sphere.radius += offscreenMargin;
+                    if(!screen.testSphere(sphere))
+                        tier = LOD_FROZEN;
+                }
+            }
+
+            if(lodTier[i] == LOD_FROZEN && tier != LOD_FROZEN)
+                thaw(i, index);
+
+            float scale = 1.0f;
+            if(tier == LOD_FAR)
+                scale = (stepCount + i) % farDivider == 0 ? (float)farDivider : 0.0f;
+            else if(tier == LOD_FROZEN)
+            {
+                scale = 0.0f;
+                frozenTime[i] += deltaTime;
+            }
+
+            lodTier[i] = tier;
+            lodMoved[i] = lodScale[i] > 0.0f;
+            lodScale[i] = scale;
+            bodies.timeScale[index] = scale;
+        }
+    }
+
+    public:
+    physicsWorld(broadphaseMode mode = sweepAndPrune, float cellSize = 20.0f, int threadCount = 0)
+    {
+        this->mode = mode;
+        this->cellSize = cellSize;
+        setThreadCount(threadCount);
+    }
+
+    physicsWorld(const physicsWorld&) = delete;
+    physicsWorld &operator=(const physicsWorld&) = delete;
+
+    //the body moves into the world, the object has to be removed before it is destroyed or outlive the world
+    void addObject(gameObject *objPtr)
+    {
+        objPtr->moveBody(&bodies);
+        objPtr->wake();
+        objects.push_back(objPtr);
+        sleepIsland.push_back(-1);
+
+        //findPairs() reads the LOD arrays and may run before the next updateLOD()
+        lodTier.push_back(LOD_NEAR);
+        lodScale.push_back(1.0f);
+        lodMoved.push_back(1);
+        frozenTime.push_back(0.0f);
+        shapesDirty = true;
+        listDirty = true;
+    }
+
+    //the body goes back to defaultBodies, the object keeps its state
+    void removeObject(gameObject *objPtr)
+    {
+        auto found = std::find(objects.begin(), objects.end(), objPtr);
+        if(found == objects.end())
+            return;
+
+        //whatever rested on the object has to fall again
+        int index = found - objects.begin();
+        if(sleepIsland[index] >= 0)
+            wakeIsland(sleepIsland[index]);
+
+        objPtr->moveBody(&defaultBodies);
+        objPtr->wake();
+        objects.erase(found);
+        sleepIsland.erase(sleepIsland.begin() + index);
+
+        lodTier.erase(lodTier.begin() + index);
+        lodScale.erase(lodScale.begin() + index);
+        lodMoved.erase(lodMoved.begin() + index);
+        frozenTime.erase(frozenTime.begin() + index);
+        shapesDirty = true;
+        listDirty = true;
+    }
+
+    //0 picks one worker per core, at most 8
+    void setThreadCount(int threadCount)
+    {
+        if(threadCount <= 0)
+            threadCount = std::max(1u, std::min(8u, std::thread::hardware_concurrency()));
+        this->threadCount = threadCount;
+    }
+
+    contactSolver &getSolver()
+    {
+        return solver;
+    }
+
+    void setBroadphase(broadphaseMode mode, float cellSize = 20.0f)
+    {
+        this->mode = mode;
+        this->cellSize = cellSize;
+    }
+
+    //refreshes the bounds and rebuilds the candidate pair list
+    void findPairs()
+    {
+        int size = objects.size();
+        boxes.resize(size);
+        active.resize(size);
+        staticBodies.resize(size);
+        restingBodies.resize(size);
+        pairs.clear();
+
+        for(int i = 0; i < size; i++)
+        {
+            boxes[i] = objects[i]->getColliderBounds();
+            active[i] = objects[i]->getCollisionStatus();
+            staticBodies[i] = objects[i]->getStaticStatus();
+            restingBodies[i] = staticBodies[i] || sleepIsland[i] >= 0 || lodScale[i] == 0.0f;
+
+            //far bodies pair with everything they could reach during their longer step
+            if(lodTier[i] == LOD_FAR && !restingBodies[i])
+            {
+                glm::vec3 motion = objects[i]->getVelocity() * lodStepTime * lodScale[i];
+                boxes[i].min = glm::min(boxes[i].min, boxes[i].min + motion);
+                boxes[i].max = glm::max(boxes[i].max, boxes[i].max + motion);
+            }
+        }
+
+        //a sleeping object that was moved from outside wakes its island
+        for(int i = 0; i < size; i++)
+        {
+            if(sleepIsland[i] >= 0 && !objects[i]->getSleepingStatus())
+                wakeIsland(sleepIsland[i]);
+        }
+
+        if(mode == sweepAndPrune)
+            sweepPairs();
+        else
+            hashPairs();
+    }
+
+    //integrates all bodies in one batch, then finds and solves the contacts
+    void step(float deltaTime)
+    {
+        for(gameObject *objPtr : objects)
+            objPtr->fixedUpdate(deltaTime);
+
+        updateLOD(deltaTime);
+
+        //forces first, then the contacts of the current positions are solved and the bodies move
+        bodies.integrateVelocities(deltaTime);
+
+        findPairs();
+
+        //shapes are computed once, the pair tests then only read them. Sleeping and paused objects keep theirs
+        shapes.resize(objects.size());
+        for(int i = 0, s = objects.size(); i < s; i++)
+        {
+            if(shapesDirty || (sleepIsland[i] < 0 && (lodScale[i] > 0.0f || lodMoved[i])))
+                shapes[i] = objects[i]->getCollisionShape();
+        }
+        shapesDirty = false;
+
+        generateContacts();
+        wakeTouchedIslands();
+        solveContacts(deltaTime);
+        sweepBullets(deltaTime);
+
+        bodies.integratePositions(deltaTime);
+        solver.correctPositions(bodies, deltaTime);
+        applySweepHits();
+
+        for(int i = 0, s = objects.size(); i < s; i++)
+        {
+            if(sleepIsland[i] < 0 && lodScale[i] > 0.0f)
+                objects[i]->updateTransform();
+        }
+
+        if(sleepEnabled)
+            updateSleep(deltaTime);
+    }
+
+    /* bodies slower than velocity for time seconds fall asleep with their island,
+    disabling it wakes everything on the next step */
+    void setSleeping(bool enabled, float velocity = 1.0f, float time = 0.5f)
+    {
+        sleepEnabled = enabled;
+        sleepVelocity = velocity;
+        timeToSleep = time;
+
+        if(!enabled)
+        {
+            for(int i = 0, s = objects.size(); i < s; i++)
+                objects[i]->wake();
+        }
+    }
+
+    /* physics LOD: bodies closer than nearDistance to the focus tick every step, bodies up to farDistance
+    tick every farDivider steps and only collide with static and near bodies, anything further is frozen.
+    With freezeOffscreen bodies outside the view are frozen too, margin grows the view test. Frozen bodies
+    without collision are moved on by their velocity and gravity when they thaw. nearDistance <= 0 turns
+    it off */
+    void setLOD(float nearDistance, float farDistance, int farDivider = 4, bool freezeOffscreen = false, float margin = 10.0f)
+    {
+        lodEnabled = nearDistance > 0.0f;
+        lodNear = nearDistance;
+        lodFar = std::max(nearDistance, farDistance);
+        this->farDivider = std::max(1, farDivider);
+        this->freezeOffscreen = freezeOffscreen;
+        offscreenMargin = margin;
+    }
+
+    void setLODFocus(glm::vec3 point)
+    {
+        lodPoint = point;
+        lodObject = NULL;
+    }
+
+    //the object is always simulated in full, it has to be removed as focus before it is destroyed
+    void setLODFocus(gameObject *objPtr)
+    {
+        lodObject = objPtr;
+    }
+
+    //bodies in the tier on the last step
+    int getLODCount(physicsLOD tier)
+    {
+        return std::count(lodTier.begin(), lodTier.end(), (char)tier);
+    }
+
+    int getAwakeCount()
+    {
+        int count = 0;
+        for(int i = 0, s = objects.size(); i < s; i++)
+            count += sleepIsland[i] < 0 && !objects[i]->getStaticStatus();
+        return count;
+    }
+
+    int getBatchCount()
+    {
+        int count = 0;
+        for(int colour = 0, s = batchStart.size() - 1; colour < s; colour++)
+            count += batchStart[colour + 1] > batchStart[colour];
+        return count;
+    }
+
+    const std::vector<contact> &getContacts()
+    {
+        return contacts;
+    }
+
+    //one fixed step of the clock, split into its substeps
+    void fixedStep(fixedTimestep &clock)
+    {
+        bodies.storePrevious();
+
+        for(int i = 0; i < clock.getSubsteps(); i++)
+            step(clock.getSubstepTime());
+    }
+
+    //runs the fixed steps that fit into the frame time and sets up the interpolation for drawing
+    void update(float frameTime, fixedTimestep &clock)
+    {
+        int steps = clock.advance(frameTime);
+        for(int i = 0; i < steps; i++)
+            fixedStep(clock);
+
+        bodies.setInterpolation(clock.getAlpha());
+    }
+
+    void setInterpolation(float alpha)
+    {
+        bodies.setInterpolation(alpha);
+    }
+
+    const std::vector<bodyPair> &getPairs()
+    {
+        return pairs;
+    }
+
+    const std::vector<gameObject*> &getObjects()
+    {
+        return objects;
+    }
+
+    int getObjectCount()
+    {
+        return objects.size();
+    }
+
+    bodyStorage &getBodies()
+    {
+        return bodies;
+    }
+
+    /* writes the whole simulation state into one block: the body arrays, the warm start impulses, the
+    sleeping islands and the sweep order, so stepping on from a loaded snapshot gives the same result as
+    the first time. A snapshot only loads into the world it came from with the same objects, state the
+    objects keep themselves (the jump buffer of the player) is up to the game */
+    void saveSnapshot(std::vector<unsigned char> &data)
+    {
+        snapshotHeader header = {bodies.size(), (int)objects.size(), solver.getManifoldCount(), listDirty ? 0 : (int)axisList.size(), nextIsland,
+                                 (int)frozenTime.size(), stepCount};
+
+        size_t bodyBytes = bodyStorage::stateSize(header.bodyCount);
+        size_t cacheBytes = solver.cacheSize();
+        size_t islandBytes = header.objectCount * sizeof(int);
+        size_t lodBytes = header.lodCount * (sizeof(float) + 1);
+
+        data.resize(sizeof(snapshotHeader) + bodyBytes + cacheBytes + islandBytes + header.axisCount * sizeof(int) + lodBytes);
+        unsigned char *out = data.data();
+
+        std::memcpy(out, &header, sizeof(snapshotHeader));
+        out += sizeof(snapshotHeader);
+        bodies.saveState(out);
+        out += bodyBytes;
+        std::memcpy(out, sleepIsland.data(), islandBytes);
+        out += islandBytes;
+
+        for(int i = 0; i < header.axisCount; i++)
+        {
+            std::memcpy(out, &axisList[i].index, sizeof(int));
+            out += sizeof(int);
+        }
+
+        std::memcpy(out, frozenTime.data(), header.lodCount * sizeof(float));
+        out += header.lodCount * sizeof(float);
+
+        /* the cache changes size whenever contacts start or end, after the fixed size parts it only moves
+        the tiers and the snapshots of two frames still line up for a delta. The tiers last, they are the
+        only part that is not a multiple of 4 bytes */
+        solver.saveCache(out);
+        out += cacheBytes;
+        std::memcpy(out, lodTier.data(), header.lodCount);
+    }
+
+    bool loadSnapshot(const std::vector<unsigned char> &data)
+    {
+        snapshotHeader header;
+        if(data.size() < sizeof(snapshotHeader))
+        {
+            std::cout << "ERROR::PHYSICS::SNAPSHOT_TOO_SMALL\n";
+            return false;
+        }
+        std::memcpy(&header, data.data(), sizeof(snapshotHeader));
+
+        size_t bodyBytes = bodyStorage::stateSize(header.bodyCount);
+        size_t cacheBytes = header.cacheCount * (sizeof(uint64_t) + sizeof(float));
+        size_t islandBytes = header.objectCount * sizeof(int);
+        size_t lodBytes = header.lodCount * (sizeof(float) + 1);
+
+        if(header.bodyCount != bodies.size() || header.objectCount != (int)objects.size() ||
+           (header.lodCount != 0 && header.lodCount != header.objectCount) ||
+           data.size() != sizeof(snapshotHeader) + bodyBytes + cacheBytes + islandBytes + header.axisCount * sizeof(int) + lodBytes)
+        {
+            std::cout << "ERROR::PHYSICS::SNAPSHOT_DOES_NOT_MATCH_WORLD\n";
+            return false;
+        }
+
+        const unsigned char *in = data.data() + sizeof(snapshotHeader);
+        bodies.loadState(in);
+        in += bodyBytes;
+        std::memcpy(sleepIsland.data(), in, islandBytes);
+        in += islandBytes;
+
+        nextIsland = header.nextIsland;
+        listDirty = header.axisCount != header.objectCount;
+        if(!listDirty)
+        {
+            axisList.resize(header.axisCount);
+            for(int i = 0; i < header.axisCount; i++)
+            {
+                std::memcpy(&axisList[i].index, in, sizeof(int));
+                in += sizeof(int);
+            }
+        }
+        else
+            in += header.axisCount * sizeof(int);
+
+        stepCount = header.stepCount;
+        frozenTime.resize(header.lodCount);
+        lodTier.resize(header.lodCount);
+        lodScale.assign(header.lodCount, 1.0f);
+        lodMoved.assign(header.lodCount, 1);
+        std::memcpy(frozenTime.data(), in, header.lodCount * sizeof(float));
+        in += header.lodCount * sizeof(float);
+        solver.loadCache(in, header.cacheCount);
+        in += cacheBytes;
+        std::memcpy(lodTier.data(), in, header.lodCount);
+
+        //a snapshot taken before the first step has no LOD state, the bodies start near
+        frozenTime.resize(objects.size(), 0.0f);
+        lodTier.resize(objects.size(), LOD_NEAR);
+        lodScale.resize(objects.size(), 1.0f);
+        lodMoved.resize(objects.size(), 1);
+
+        shapesDirty = true;
+        for(gameObject *objPtr : objects)
+            objPtr->updateTransform();
+        return true;
+    }
+
+    ~physicsWorld()
+    {
+        for(gameObject *objPtr : objects)
+            objPtr->moveBody(&defaultBodies);
+    }
+};
+
+/* pairs of both broadphases against testing every pair, on boxCount random boxes of which every tenth is
+static. Returns the number of modes that found a different pair set, 0 when both match */
+inline int checkBroadphase(int boxCount = 10000)
+{
+    std::vector<std::unique_ptr<gameObject>> objects;
+    physicsWorld world;
+
+    srand(1);
+    for(int i = 0; i < boxCount; i++)
+    {
+        gameObject *object = new gameObject();
+        object->block3D(1.0f + rand() % 8, 1.0f + rand() % 8, 1.0f + rand() % 8);
+        object->setCollisionStatus(true);
+        object->setStatic(i % 10 == 0);
+        object->setPosition(glm::vec3(rand() % 1000, rand() % 1000, rand() % 40));
+        object->updateTransform();
+        world.addObject(object);
+        objects.emplace_back(object);
+    }
+
+    std::vector<boundingBox> boxes(boxCount);
+    for(int i = 0; i < boxCount; i++)
+        boxes[i] = objects[i]->getColliderBounds();
+
+    std::vector<uint64_t> expected;
+    for(int a = 0; a < boxCount; a++)
+    {
+        for(int b = a + 1; b < boxCount; b++)
+        {
+            if(a % 10 == 0 && b % 10 == 0)
+                continue;
+
+            if(boxes[a].min.x <= boxes[b].max.x && boxes[a].max.x >= boxes[b].min.x &&
+               boxes[a].min.y <= boxes[b].max.y && boxes[a].max.y >= boxes[b].min.y &&
+               boxes[a].min.z <= boxes[b].max.z && boxes[a].max.z >= boxes[b].min.z)
+                expected.push_back((uint64_t)a << 32 | b);
+        }
+    }
+
+    int failed = 0;
+    for(broadphaseMode mode : {sweepAndPrune, spatialHash})
+    {
+        world.setBroadphase(mode);
+        world.findPairs();
+
+        std::vector<uint64_t> found;
+        for(const bodyPair &pair : world.getPairs())
+            found.push_back((uint64_t)pair.a << 32 | pair.b);
+        std::sort(found.begin(), found.end());
+
+        if(found != expected)
+        {
+            std::cout << "ERROR::PHYSICS::BROADPHASE_CHECK_FAILED: mode " << mode << ", " << found.size() << " pairs, " << expected.size() << " expected\n";
+            failed++;
+        }
+    }
+
+    for(const std::unique_ptr<gameObject> &object : objects)
+        world.removeObject(object.get());
+    return failed;
+}
+
+struct stackCheckResult{
+    float drop = 0.0f; // how far the top block sank below where it started
+    float speed = 0.0f; // fastest block during the last second
+};
+
+//a stack of height blocks on the ground stepped for seconds at dt with the given solver iterations
+inline stackCheckResult checkStack(bool warmStarting, int height = 10, float dt = 1.0f / 30.0f, int iterations = 4, float seconds = 10.0f)
+{
+    std::vector<std::unique_ptr<gameObject>> objects;
+    gameObject floor;
+    physicsWorld world;
+
+    world.getSolver().setIterations(iterations);
+    world.getSolver().setWarmStarting(warmStarting);
+    world.setSleeping(false);
+
+    floor.block2D(40.0f, 2.0f);
+    floor.setCollisionStatus(true);
+    floor.setStatic(true);
+    floor.setPosition(glm::vec3(0.0f, -1.0f, 0.0f));
+    floor.updateTransform();
+    world.addObject(&floor);
+
+    for(int i = 0; i < height; i++)
+    {
+        gameObject *block = new gameObject();
+        block->block2D(2.0f, 2.0f);
+        block->setCollisionStatus(true);
+        block->setRestitution(0.0f);
+        block->setGravityStatus(true);
+        block->setAcceleration(GRAVITY);
+        block->setPosition(glm::vec3(0.0f, 1.0f + 2.0f * i, 0.0f));
+        block->updateTransform();
+        world.addObject(block);
+        objects.emplace_back(block);
+    }
+
+    stackCheckResult result;
+    float top = objects.back()->getPosition().y;
+    int steps = seconds / dt;
+    for(int step = 0; step < steps; step++)
+    {
+        world.step(dt);
+
+        if(step * dt >= seconds - 1.0f)
+        {
+            for(const std::unique_ptr<gameObject> &block : objects)
+                result.speed = std::max(result.speed, glm::length(block->getVelocity()));
+        }
+    }
+    result.drop = top - objects.back()->getPosition().y;
+
+    for(const std::unique_ptr<gameObject> &block : objects)
+        world.removeObject(block.get());
+    world.removeObject(&floor);
+    return result;
+}
+
+struct sleepBenchmarkResult{
+    double awakeTime = 0.0; // milliseconds per step with sleeping disabled
+    double asleepTime = 0.0; // milliseconds per step once every stack sleeps
+    int awakeCount = 0; // bodies still awake in the second run
+};
+
+//stackCount stacks of height blocks that settle on a floor, stepped with and without sleeping
+inline sleepBenchmarkResult benchmarkSleeping(int stackCount = 200, int height = 5, int steps = 200)
+{
+    std::vector<std::unique_ptr<gameObject>> objects;
+    gameObject floor;
+    physicsWorld world;
+
+    floor.block2D(stackCount * 4.0f + 10.0f, 2.0f);
+    floor.setCollisionStatus(true);
+    floor.setStatic(true);
+    floor.setPosition(glm::vec3(stackCount * 2.0f, -1.0f, 0.0f));
+    floor.updateTransform();
+    world.addObject(&floor);
+
+    for(int stack = 0; stack < stackCount; stack++)
+    {
+        for(int i = 0; i < height; i++)
+        {
+            gameObject *block = new gameObject();
+            block->block2D(2.0f, 2.0f);
+            block->setCollisionStatus(true);
+            block->setRestitution(0.0f);
+            block->setGravityStatus(true);
+            block->setAcceleration(GRAVITY);
+            block->setPosition(glm::vec3(stack * 4.0f + 2.0f, 1.0f + 2.0f * i, 0.0f));
+            block->updateTransform();
+            world.addObject(block);
+            objects.emplace_back(block);
+        }
+    }
+
+    const float dt = 1.0f / 60.0f;
+    sleepBenchmarkResult result;
+
+    //settled but awake
+    world.setSleeping(false);
+    for(int step = 0; step < 120; step++)
+        world.step(dt);
+
+    auto start = std::chrono::steady_clock::now();
+    for(int step = 0; step < steps; step++)
+        world.step(dt);
+    auto end = std::chrono::steady_clock::now();
+    result.awakeTime = std::chrono::duration<double, std::milli>(end - start).count() / steps;
+
+    world.setSleeping(true);
+    for(int step = 0; step < 120; step++)
+        world.step(dt);
+
+    start = std::chrono::steady_clock::now();
+    for(int step = 0; step < steps; step++)
+        world.step(dt);
+    end = std::chrono::steady_clock::now();
+    result.asleepTime = std::chrono::duration<double, std::milli>(end - start).count() / steps;
+    result.awakeCount = world.getAwakeCount();
+
+    for(const std::unique_ptr<gameObject> &block : objects)
+        world.removeObject(block.get());
+    world.removeObject(&floor);
+    return result;
+}
+
+#endif
@@ -0,0 +1,258 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <vector>
+#include <memory>
+#include <chrono>
+
+#include <glm/glm.hpp>
+
+#include "game.h"
+#include "physics.h"
+
+//size of a pooled obstacle, obstacles of the same shape share one free list
+struct obstacleShape{
+    int type = SHAPE_AABB; // SHAPE_AABB or SHAPE_SPHERE
+    float length = 0.0f; // radius for SHAPE_SPHERE
+    float breadth = 0.0f;
+    float width = 0.0f; // 0 for flat blocks
+
+    bool operator==(const obstacleShape &other) const
+    {
+        return type == other.type && length == other.length && breadth == other.breadth && width == other.width;
+    }
+};
+
+/* recycles obstacles instead of building new ones as the level scrolls. An obstacle keeps its mesh and GL
+buffers after despawn() and goes onto the free list of its shape, spawn() takes one from there and only
+resets the body and the transform, so after reserve() a wave of obstacles does not touch the GPU or the heap.
+Active obstacles are added to the physicsWorld given to the pool and removed again on despawn().
+The pool owns its obstacles and has to be destroyed before the world */
+class obstaclePool{
+    private:
+    struct bucket{
+        obstacleShape shape;
+        bodyState initial; // body of a freshly built obstacle, restored on every spawn
+        std::vector<obstacle*> free;
+    };
+
+    struct activeObstacle{
+        obstacle *object;
+        int bucket;
+    };
+
+    shader *modelShader;
+    physicsWorld *world;
+
+    std::vector<bucket> buckets;
+    std::vector<activeObstacle> active;
+    std::vector<std::unique_ptr<obstacle>> owned;
+    int builtCount = 0;
+
+    int findBucket(const obstacleShape &shape)
+    {
+        for(int i = 0, s = buckets.size(); i < s; i++)
+        {
+            if(buckets[i].shape == shape)
+                return i;
+        }
+
+        bucket created;
+        created.shape = shape;
+        buckets.push_back(created);
+        return buckets.size() - 1;
+    }
+
+    //the only place that builds meshes and uploads buffers
+    obstacle *build(int index)
+    {
+        const obstacleShape &shape = buckets[index].shape;
+
+        obstacle *created;
+        if(shape.type == SHAPE_SPHERE)
+            created = new obstacle(modelShader, shape.length);
+        else
+            created = new obstacle(modelShader, shape.length, shape.breadth, shape.width);
+
+        buckets[index].initial = created->getBodyStorage()->getState(created->getBody());
+
+        owned.emplace_back(created);
+        builtCount++;
+        return created;
+    }
+
+    public:
+    obstaclePool(shader *modelShader, physicsWorld *world = NULL)
+    {
+        this->modelShader = modelShader;
+        this->world = world;
+    }
+
+    obstaclePool(const obstaclePool&) = delete;
+    obstaclePool &operator=(const obstaclePool&) = delete;
+
+    ~obstaclePool()
+    {
+        despawnAll();
+    }
+
+    //builds count obstacles of the shape up front, call while loading so waves never build one
+    void reserve(const obstacleShape &shape, int count)
+    {
+        int index = findBucket(shape);
+        while((int)buckets[index].free.size() < count)
+            buckets[index].free.push_back(build(index));
+        active.reserve(owned.size());
+    }
+
+    //a recycled obstacle when one is free, a new one otherwise
+    obstacle *spawn(const obstacleShape &shape, glm::vec3 position)
+    {
+        int index = findBucket(shape);
+        bucket &found = buckets[index];
+
+        obstacle *spawned;
+        if(!found.free.empty())
+        {
+            spawned = found.free.back();
+            found.free.pop_back();
+        }
+        else
+            spawned = build(index);
+
+        if(world != NULL)
+            world->addObject(spawned);
+
+        bodyState state = found.initial;
+        state.position = position;
+        spawned->getBodyStorage()->setState(spawned->getBody(), state);
+        spawned->setModelMatrix(glm::mat4(1.0f));
+        spawned->updateTransform();
+
+        active.push_back({spawned, index});
+        return spawned;
+    }
+
+    //puts the obstacle back on its free list, the mesh and buffers stay for the next spawn
+    void despawn(obstacle *objPtr)
+    {
+        for(int i = 0, s = active.size(); i < s; i++)
+        {
+            if(active[i].object != objPtr)
+                continue;
+
+            if(world != NULL)
+                world->removeObject(objPtr);
+
+            buckets[active[i].bucket].free.push_back(objPtr);
+            active[i] = active.back();
+            active.pop_back();
+            return;
+        }
+
+        std::cout << "ERROR::POOL::OBSTACLE_NOT_ACTIVE\n";
+    }
+
+    //despawns every active obstacle the condition returns true for, condition(obstacle*)
+    template<typename F>
+    int despawnIf(F condition)
+    {
+        int despawned = 0;
+        for(int i = active.size() - 1; i >= 0; i--)
+        {
+            if(!condition(active[i].object))
+                continue;
+
+            despawn(active[i].object);
+            despawned++;
+        }
+        return despawned;
+    }
+
+    /* the obstacles the camera left behind, with the test fall() uses: view space x further left than
+    limit. limit should be past the -100 where fall() drops them, so they are seen falling */
+    int despawnOffscreen(float limit = -200.0f)
+    {
+        return despawnIf([limit](obstacle *objPtr)
+        {
+            glm::vec4 point = view * objPtr->getModelMatrix() * glm::vec4(objPtr->getPosition(), 1.0f);
+            return point.x < limit;
+        });
+    }
+
+    void despawnAll()
+    {
+        while(!active.empty())
+            despawn(active.back().object);
+    }
+
+    //calls function(obstacle*) for the active obstacles, to draw or update them
+    template<typename F>
+    void forEachActive(F function)
+    {
+        for(int i = 0, s = active.size(); i < s; i++)
+            function(active[i].object);
+    }
+
+    int getActiveCount()
+    {
+        return active.size();
+    }
+
+    int getFreeCount(const obstacleShape &shape)
+    {
+        for(int i = 0, s = buckets.size(); i < s; i++)
+        {
+            if(buckets[i].shape == shape)
+                return buckets[i].free.size();
+        }
+        return 0;
+    }
+
+    //obstacles built so far, stops growing once the pool is warm
+    int getBuiltCount()
+    {
+        return builtCount;
+    }
+};
+
+struct poolBenchmarkResult{
+    double buildTime = 0.0; // microseconds per obstacle built with new, mesh and buffers included
+    double spawnTime = 0.0; // microseconds per spawn and despawn from a warm pool
+};
+
+//builds and deletes count obstacles, then spawns and despawns the same count from a reserved pool
+inline poolBenchmarkResult benchmarkObstaclePool(shader *modelShader, int count = 200, int waves = 20)
+{
+    poolBenchmarkResult result;
+    obstacleShape shape;
+    shape.length = 4.0f;
+    shape.breadth = 6.0f;
+
+    auto start = std::chrono::steady_clock::now();
+    for(int wave = 0; wave < waves; wave++)
+    {
+        std::vector<std::unique_ptr<obstacle>> obstacles;
+        for(int i = 0; i < count; i++)
+            obstacles.emplace_back(new obstacle(modelShader, shape.length, shape.breadth));
+    }
+    auto middle = std::chrono::steady_clock::now();
+
+    obstaclePool pool(modelShader);
+    pool.reserve(shape, count);
+
+    auto poolStart = std::chrono::steady_clock::now();
+    for(int wave = 0; wave < waves; wave++)
+    {
+        for(int i = 0; i < count; i++)
+            pool.spawn(shape, glm::vec3(i * 10.0f, 0.0f, 0.0f));
+        pool.despawnAll();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    result.buildTime = std::chrono::duration<double, std::micro>(middle - start).count() / (waves * count);
+    result.spawnTime = std::chrono::duration<double, std::micro>(end - poolStart).count() / (waves * count);
+    return result;
+}
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef RENDERTHREAD_H
+#define RENDERTHREAD_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <vector>
+
+#include "game.h"
+
+/* runs all GL work on its own thread so the simulation of frame N+1 overlaps with the submission of
+frame N. The game thread records into one commandBuffer while the render thread replays the other one.
+Anything that touches GL outside of drawing (creating meshes, loading shaders) has to be queued
+with runOnRenderThread() once the thread is started, since the game thread no longer owns the context */
+class renderThread{
+    private:
+    GLFWwindow *window = NULL;
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable frameSubmitted;
+    std::condition_variable frameFinished;
+
+    //double buffered frames, the game thread owns buffers[recording], the render thread the other one
+    commandBuffer buffers[2];
+    int recording = 0;
+    bool pending = false; // a submitted frame is waiting for the render thread
+    bool rendering = false; // the render thread is busy with a frame or with tasks
+    bool running = false;
+
+    std::vector<std::function<void()>> tasks;
+    std::function<void()> beforeFrame; // called on the render thread before every frame, e.g. glClear
+
+    void loop()
+    {
+        glfwMakeContextCurrent(window);
+
+        while(true)
+        {
+            std::vector<std::function<void()>> frameTasks;
+            int executing;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                frameSubmitted.wait(lock, [this]{ return pending || !running || !tasks.empty(); });
+
+                frameTasks.swap(tasks);
+                if(!pending && !running && frameTasks.empty())
+                    break;
+
+                executing = pending ? 1 - recording : -1;
+                pending = false;
+                rendering = executing >= 0 || !frameTasks.empty();
+            }
+
+            for(std::function<void()> &task : frameTasks)
+                task();
+
+            if(executing >= 0)
+            {
+                if(beforeFrame)
+                    beforeFrame();
+
+                buffers[executing].execute();
+                glfwSwapBuffers(window);
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                rendering = false;
+            }
+            frameFinished.notify_all();
+        }
+
+        glfwMakeContextCurrent(NULL);
+    }
+
+    public:
+    renderThread()
+    {
+    }
+
+    renderThread(const renderThread&) = delete;
+    renderThread &operator=(const renderThread&) = delete;
+
+    //hands the context of the window over to the render thread
+    void start(GLFWwindow *window, std::function<void()> beforeFrame = std::function<void()>())
+    {
+        this->window = window;
+        this->beforeFrame = beforeFrame;
+        running = true;
+
+        glfwMakeContextCurrent(NULL);
+        thread = std::thread(&renderThread::loop, this);
+    }
+
+    //finishes the queued work and gives the context back to the calling thread
+    void stop()
+    {
+        if(!thread.joinable())
+            return;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running = false;
+        }
+        frameSubmitted.notify_all();
+        thread.join();
+
+        glfwMakeContextCurrent(window);
+    }
+
+    //the buffer to record the next frame into, only valid until submit()
+    commandBuffer &beginFrame(const glm::mat4 &viewMatrix, const glm::mat4 &projectionMatrix, light lightSource, glm::vec3 cameraPosition)
+    {
+        commandBuffer &buffer = buffers[recording];
+        buffer.begin(viewMatrix, projectionMatrix, lightSource, cameraPosition);
+        return buffer;
+    }
+
+    //hands the recorded frame over, waits only if the render thread has not finished the previous one yet
+    void submit()
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            frameFinished.wait(lock, [this]{ return !pending && !rendering; });
+
+            pending = true;
+            recording = 1 - recording;
+        }
+        frameSubmitted.notify_one();
+    }
+
+    //runs a GL job on the render thread before the next frame
+    void runOnRenderThread(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back(task);
+        }
+        frameSubmitted.notify_one();
+    }
+
+    //blocks until every submitted frame and queued task is done
+    void flush()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        frameFinished.wait(lock, [this]{ return !pending && !rendering && tasks.empty(); });
+    }
+
+    ~renderThread()
+    {
+        stop();
+    }
+};
+
+#endif
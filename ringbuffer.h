@@ -0,0 +1,214 @@
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+//uniform buffer binding point the per draw data is bound to
+const unsigned int DRAW_DATA_BINDING = 1;
+
+/* per draw data in std140 layout, shaders read it through
+    layout(std140) uniform DrawData { mat4 model; vec4 baseColor; vec4 highlightColor; };
+instead of the separate model/baseColor/highlightColor uniforms */
+struct drawData{
+    glm::mat4 model;
+    glm::vec4 baseColor;
+    glm::vec4 highlightColor;
+};
+
+/* persistently mapped buffer split into regions (3 by default), one region is written by the CPU while
+the GPU still reads the older ones. A fence per region makes sure a region is not overwritten before the
+GPU is done with it. Needs GL 4.4 (ARB_buffer_storage), isValid() is false without it */
+class ringBuffer{
+    private:
+    static const int maxRegions = 4;
+
+    unsigned int buffer = 0;
+    GLenum target = GL_UNIFORM_BUFFER;
+    char* mapped = NULL;
+
+    size_t regionSize = 0;
+    int regionCount = 0;
+    int current = 0;
+    size_t offset = 0; // write position inside the current region
+    size_t alignment = 256;
+
+    GLsync fences[maxRegions] = {};
+
+    public:
+    ringBuffer()
+    {
+    }
+
+    ringBuffer(size_t regionSize, GLenum target = GL_UNIFORM_BUFFER, int regions = 3)
+    {
+        create(regionSize, target, regions);
+    }
+
+    //owns a mapping, copies would unmap it twice
+    ringBuffer(const ringBuffer&) = delete;
+    ringBuffer &operator=(const ringBuffer&) = delete;
+
+    static bool supported()
+    {
+#ifdef GL_VERSION_4_4
+        return GLAD_GL_VERSION_4_4;
+#else
+        return false;
+#endif
+    }
+
+    bool create(size_t regionSize, GLenum target = GL_UNIFORM_BUFFER, int regions = 3)
+    {
+        destroy();
+
+        if(!supported())
+            return false;
+
+#ifdef GL_VERSION_4_4
+        //offsets passed to glBindBufferRange have to respect the driver alignment
+        int offsetAlignment = 256;
+        if(target == GL_UNIFORM_BUFFER)
+            glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+        else if(target == GL_SHADER_STORAGE_BUFFER)
+            glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+
+        this->alignment = offsetAlignment > 0 ? offsetAlignment : 256;
+        this->target = target;
+        this->regionCount = std::max(1, std::min(regions, maxRegions));
+        this->regionSize = (regionSize + alignment - 1) / alignment * alignment;
+
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        size_t totalSize = this->regionSize * regionCount;
+
+        glGenBuffers(1, &buffer);
+        glBindBuffer(target, buffer);
+        glBufferStorage(target, totalSize, NULL, flags);
+        mapped = (char*)glMapBufferRange(target, 0, totalSize, flags);
+        glBindBuffer(target, 0);
+
+        if(!mapped)
+        {
+            std::cout << "ERROR::RINGBUFFER::MAPPING_FAILED\n";
+            destroy();
+            return false;
+        }
+
+        current = 0;
+        offset = 0;
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void destroy()
+    {
+        for(int i = 0; i < maxRegions; i++)
+        {
+            if(fences[i])
+                glDeleteSync(fences[i]);
+            fences[i] = 0;
+        }
+
+        if(buffer)
+        {
+            if(mapped)
+            {
+                glBindBuffer(target, buffer);
+                glUnmapBuffer(target);
+                glBindBuffer(target, 0);
+            }
+            glDeleteBuffers(1, &buffer);
+        }
+
+        buffer = 0;
+        mapped = NULL;
+        regionCount = 0;
+    }
+
+    //waits until the GPU released the region that is written next, call before the first allocate() of a frame
+    void beginFrame()
+    {
+        if(!mapped)
+            return;
+
+        GLsync fence = fences[current];
+        if(fence)
+        {
+            GLenum result = glClientWaitSync(fence, 0, 0);
+            while(result == GL_TIMEOUT_EXPIRED)
+                result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+
+            glDeleteSync(fence);
+            fences[current] = 0;
+        }
+        offset = 0;
+    }
+
+    //fences everything written this frame and moves on to the next region
+    void endFrame()
+    {
+        if(!mapped)
+            return;
+
+        fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        current = (current + 1) % regionCount;
+    }
+
+    /* returns a write pointer for size bytes and the buffer offset to bind it with,
+    NULL if the region of this frame is full */
+    void* allocate(size_t size, size_t &bufferOffset)
+    {
+        if(!mapped)
+            return NULL;
+
+        size_t aligned = (offset + alignment - 1) / alignment * alignment;
+        if(aligned + size > regionSize)
+            return NULL;
+
+        offset = aligned + size;
+        bufferOffset = current * regionSize + aligned;
+        return mapped + bufferOffset;
+    }
+
+    //copies the data in and binds it to the binding point, false if the region is full
+    bool push(const void* data, size_t size, unsigned int binding)
+    {
+        size_t bufferOffset;
+        void* destination = allocate(size, bufferOffset);
+        if(!destination)
+            return false;
+
+        memcpy(destination, data, size);
+        glBindBufferRange(target, binding, buffer, bufferOffset, size);
+        return true;
+    }
+
+    bool isValid()
+    {
+        return mapped != NULL;
+    }
+
+    unsigned int getBuffer()
+    {
+        return buffer;
+    }
+
+    size_t getRegionSize()
+    {
+        return regionSize;
+    }
+
+    ~ringBuffer()
+    {
+        destroy();
+    }
+};
+
+#endif
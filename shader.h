@@ -6,135 +6,470 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
+#include <map>
+#include <iterator>
+#include <algorithm>
+#include <filesystem>
+#include <cstdio>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>  // For transformations like translate, rotate, scale
 #include <glm/gtc/type_ptr.hpp>
 
+#include "glresource.h"
+
 class shader
 {
     public:
-    unsigned int progID; //program ID of the shader program
+    enum buildStatus { notLoaded, compiling, ready, failed };
+
+    glProgram progID; //program ID of the shader program, deleted with the shader
+    buildStatus status = notLoaded;
+    bool loadedFromCache = false; //true if the last loadShaders() call used a cached binary
+
+    /* linked programs are stored here as driver binaries so later launches skip compiling,
+    set it to an empty string to disable the cache */
+    std::string cacheDirectory = "shader_cache";
+
+    //stages of a build that is still running, see loadShadersAsync()
+    glShaderStage pendingVertex, pendingFragment;
+    std::string pendingCachePath;
+    shader *fallback = NULL;
+    std::map<std::string, bool> uniformBlocks; //blocks already bound by bindUniformBlock()
+
+    shader()
+    {
+    }
+
+    //owns its program, so a shader can be moved but not copied
+    shader(const shader&) = delete;
+    shader &operator=(const shader&) = delete;
+    shader(shader&&) = default;
+    shader &operator=(shader&&) = default;
+
+    //installs a new program, the uniform block bindings of the old one do not carry over
+    void replaceProgram(unsigned int program)
+    {
+        progID.reset(program);
+        uniformBlocks.clear();
+    }
+
+    void setCacheDirectory(const std::string &directory)
+    {
+        cacheDirectory = directory;
+    }
 
     void loadShaders(const char* vertexPath, const char* fragmentPath)
+    {
+        loadShadersAsync(vertexPath, fragmentPath);
+
+        //wait for the driver right away
+        if(status == compiling)
+            finishBuild();
+    }
+
+    /* issues the compile and link without waiting for the result, call isReady() every frame
+    to find out when the program can be used. Many shaders can be started back to back this way */
+    void loadShadersAsync(const char* vertexPath, const char* fragmentPath)
     {
         // 1. Retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        //exception handling
-        vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+        std::string vertexCode = readFile(vertexPath);
+        std::string fragmentCode = readFile(fragmentPath);
 
-        try
+        // 2. Try the program binary cache first
+        loadedFromCache = false;
+        pendingCachePath.clear();
+
+        if(binaryCacheSupported())
         {
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
+            pendingCachePath = cacheDirectory + "/" + cacheKey(vertexCode, fragmentCode) + ".bin";
+            if(loadBinary(pendingCachePath))
+            {
+                loadedFromCache = true;
+                status = ready;
+                return;
+            }
+        }
 
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();
-            
-            vShaderFile.close();
-            fShaderFile.close();
+        // 3. Compile and link from source, the status is only queried once the driver is done
+        unsigned int vertex, fragment;
+        replaceProgram(startProgram(vertexCode.c_str(), fragmentCode.c_str(), !pendingCachePath.empty(), vertex, fragment));
+        pendingVertex.reset(vertex);
+        pendingFragment.reset(fragment);
+        status = compiling;
+    }
 
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
+    //non blocking with KHR_parallel_shader_compile, otherwise the result is fetched on the first poll
+    bool isReady()
+    {
+        if(status == compiling && buildComplete())
+            finishBuild();
 
+        return status == ready;
+    }
+
+    bool hasFailed()
+    {
+        return status == failed;
+    }
+
+    //program used in place of this one until it is ready, a chain that leads back to this one is refused
+    bool setFallback(shader *fallbackShader)
+    {
+        for(shader *link = fallbackShader; link != NULL; link = link->fallback)
+        {
+            if(link == this)
+            {
+                std::cout << "ERROR::SHADER::FALLBACK_CYCLE\n";
+                return false;
+            }
         }
-        catch(std::ifstream::failure e)
+
+        fallback = fallbackShader;
+        return true;
+    }
+
+    //the program to draw with this frame, NULL if neither this nor any fallback is ready
+    shader *getActive()
+    {
+        if(isReady())
+            return this;
+
+        if(fallback)
+            return fallback->getActive();
+
+        return NULL;
+    }
+
+    //lets the driver compile on its own threads, call once after the context is created
+    static bool enableParallelCompile(unsigned int threads = 0xFFFFFFFF)
+    {
+#ifdef GL_KHR_parallel_shader_compile
+        if(GLAD_GL_KHR_parallel_shader_compile)
         {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ\n";
+            glMaxShaderCompilerThreadsKHR(threads);
+            return true;
         }
-        
-        const char* vShaderCode = vertexCode.c_str();
-        const char* fShaderCode = fragmentCode.c_str();
+#endif
+        return false;
+    }
 
-        // 2. Compile shaders
-        unsigned int vertex, fragment;
-        int success;
-        char infoLog[512];
+    static bool parallelCompileSupported()
+    {
+#ifdef GL_KHR_parallel_shader_compile
+        return GLAD_GL_KHR_parallel_shader_compile;
+#else
+        return false;
+#endif
+    }
 
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
+    bool buildComplete()
+    {
+#ifdef GL_KHR_parallel_shader_compile
+        if(parallelCompileSupported())
+        {
+            int done = GL_FALSE;
+            glGetProgramiv(progID.get(), GL_COMPLETION_STATUS_KHR, &done);
+            return done == GL_TRUE;
+        }
+#endif
+        return true;
+    }
 
-        glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
-        if(!success)
+    void finishBuild()
+    {
+        bool success = finishProgram(progID.get(), pendingVertex.get(), pendingFragment.get());
+        pendingVertex.reset();
+        pendingFragment.reset();
+        status = success ? ready : failed;
+
+        if(success && !pendingCachePath.empty())
+            saveBinary(pendingCachePath);
+    }
+
+    static std::string readFile(const char* path)
+    {
+        std::ifstream shaderFile;
+        //exception handling
+        shaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+
+        try
+        {
+            shaderFile.open(path);
+            std::stringstream shaderStream;
+            shaderStream << shaderFile.rdbuf();
+            shaderFile.close();
+            return shaderStream.str();
+        }
+        catch(std::ifstream::failure &e)
         {
-            glGetShaderInfoLog(vertex, 512, NULL, infoLog);
-            std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << path << "\n";
         }
+        return "";
+    }
+
+    //prints the whole info log, sized by GL_INFO_LOG_LENGTH instead of a fixed buffer
+    static void printInfoLog(unsigned int object, bool isProgram, const char* message)
+    {
+        int length = 0;
+        if(isProgram)
+            glGetProgramiv(object, GL_INFO_LOG_LENGTH, &length);
+        else
+            glGetShaderiv(object, GL_INFO_LOG_LENGTH, &length);
+
+        std::string infoLog(std::max(length, 1), '\0');
+        if(isProgram)
+            glGetProgramInfoLog(object, length, NULL, &infoLog[0]);
+        else
+            glGetShaderInfoLog(object, length, NULL, &infoLog[0]);
+
+        std::cout << message << "\n" << infoLog.c_str() << std::endl;
+    }
 
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
+    static unsigned int compileStage(GLenum type, const char* code)
+    {
+        unsigned int stage = glCreateShader(type);
+        glShaderSource(stage, 1, &code, NULL);
+        glCompileShader(stage);
+        return stage;
+    }
+
+    //compiles both stages and links them without asking for any status, so the driver can work in the background
+    static unsigned int startProgram(const char* vShaderCode, const char* fShaderCode, bool retrievable, unsigned int &vertex, unsigned int &fragment)
+    {
+        vertex = compileStage(GL_VERTEX_SHADER, vShaderCode);
+        fragment = compileStage(GL_FRAGMENT_SHADER, fShaderCode);
+
+        // shaderProgam
+        unsigned int program = glCreateProgram();
+        glAttachShader(program, vertex);
+        glAttachShader(program, fragment);
+
+#ifdef GL_VERSION_4_1
+        if(retrievable)
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+#endif
+        glLinkProgram(program);
+        return program;
+    }
+
+    //checks the results of startProgram and detaches the stages, this blocks until the driver is done
+    static bool finishProgram(unsigned int program, unsigned int vertex, unsigned int fragment)
+    {
+        int success;
+
+        glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
+        if(!success)
+            printInfoLog(vertex, false, "ERROR::SHADER::VERTEX::COMPILATION_FAILED");
 
         glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
         if(!success)
+            printInfoLog(fragment, false, "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED");
+
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if(!success)
+            printInfoLog(program, true, "ERROR::SHADER::PROGRAM::LINKING_FAILED");
+
+        glDetachShader(program, vertex);
+        glDetachShader(program, fragment);
+        return success;
+    }
+
+    //program binaries need GL 4.1 and at least one binary format from the driver
+    bool binaryCacheSupported()
+    {
+        if(cacheDirectory.empty())
+            return false;
+#ifdef GL_VERSION_4_1
+        if(!GLAD_GL_VERSION_4_1)
+            return false;
+
+        int formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        return formats > 0;
+#else
+        return false;
+#endif
+    }
+
+    //64 bit FNV-1a hash
+    static unsigned long long hash(const std::string &data, unsigned long long value = 14695981039346656037ULL)
+    {
+        for(unsigned char c : data)
         {
-            glGetShaderInfoLog(fragment, 512, NULL, infoLog);
-            std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+            value ^= c;
+            value *= 1099511628211ULL;
         }
-    
-        // shaderProgam
-        progID = glCreateProgram();
-        glAttachShader(progID, vertex);
-        glAttachShader(progID, fragment);
-        glLinkProgram(progID);
+        return value;
+    }
+
+    //binaries are only valid for the same sources on the same driver, so both go into the key
+    static std::string cacheKey(const std::string &vertexCode, const std::string &fragmentCode)
+    {
+        const char* vendor = (const char*)glGetString(GL_VENDOR);
+        const char* renderer = (const char*)glGetString(GL_RENDERER);
+        const char* version = (const char*)glGetString(GL_VERSION);
+
+        unsigned long long value = hash(vertexCode);
+        value = hash(std::string(1, '\0') + fragmentCode, value);
+        value = hash(std::string(1, '\0') + (vendor ? vendor : ""), value);
+        value = hash(std::string(1, '\0') + (renderer ? renderer : ""), value);
+        value = hash(std::string(1, '\0') + (version ? version : ""), value);
+
+        char key[17];
+        snprintf(key, sizeof(key), "%016llx", value);
+        return key;
+    }
+
+    //cache file layout: binary format (GLenum) followed by the program binary
+    bool loadBinary(const std::string &path)
+    {
+#ifdef GL_VERSION_4_1
+        std::ifstream cacheFile(path, std::ios::binary);
+        if(!cacheFile.is_open())
+            return false;
 
-        glGetProgramiv(progID, GL_LINK_STATUS, &success);
+        GLenum format = 0;
+        if(!cacheFile.read((char*)&format, sizeof(format)))
+            return false;
+
+        std::vector<char> binary((std::istreambuf_iterator<char>(cacheFile)), std::istreambuf_iterator<char>());
+        if(binary.empty())
+            return false;
+
+        unsigned int program = glCreateProgram();
+        glProgramBinary(program, format, binary.data(), binary.size());
+
+        int success;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
         if(!success)
         {
-            glGetProgramInfoLog(progID, 512, NULL, infoLog);
-            std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+            //driver update or a different GPU, the caller recompiles and overwrites the file
+            glDeleteProgram(program);
+            return false;
         }
 
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
+        replaceProgram(program);
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void saveBinary(const std::string &path)
+    {
+#ifdef GL_VERSION_4_1
+        int length = 0;
+        glGetProgramiv(progID.get(), GL_PROGRAM_BINARY_LENGTH, &length);
+        if(length <= 0)
+            return;
+
+        std::vector<char> binary(length);
+        GLenum format = 0;
+        glGetProgramBinary(progID.get(), length, NULL, &format, binary.data());
+
+        std::error_code error;
+        std::filesystem::create_directories(cacheDirectory, error);
+
+        std::ofstream cacheFile(path, std::ios::binary | std::ios::trunc);
+        if(!cacheFile.is_open())
+        {
+            std::cout << "ERROR::SHADER::CACHE_NOT_WRITABLE: " << path << "\n";
+            return;
+        }
+
+        cacheFile.write((const char*)&format, sizeof(format));
+        cacheFile.write(binary.data(), binary.size());
+#endif
     }
 
     void use()
     {
-        glUseProgram(progID);
+        glUseProgram(progID.get());
     }
 
 
     void setFloat(const std::string &name, float value) const
     {
         int uniformLoc;
-        uniformLoc = glGetUniformLocation(progID, name.c_str()); 
+        uniformLoc = glGetUniformLocation(progID.get(), name.c_str()); 
         glUniform1f(uniformLoc, value); 
     }
 
     void setVec2(const std::string &name, float val1, float val2) const
     {
         int uniformLoc;
-        uniformLoc = glGetUniformLocation(progID, name.c_str()); 
+        uniformLoc = glGetUniformLocation(progID.get(), name.c_str()); 
         glUniform2f(uniformLoc, val1, val2); 
     }
 
     void setMat4(const std::string &name, glm::mat4 matrix) const
     {
         int uniformLoc;
-        uniformLoc = glGetUniformLocation(progID, name.c_str()); 
+        uniformLoc = glGetUniformLocation(progID.get(), name.c_str()); 
         glUniformMatrix4fv(uniformLoc, 1, GL_FALSE, glm::value_ptr(matrix));
     }
 
     void setVec4(const std::string &name, glm::vec4 vec4D) const
     {
         int uniformLoc;
-        uniformLoc = glGetUniformLocation(progID, name.c_str()); 
+        uniformLoc = glGetUniformLocation(progID.get(), name.c_str()); 
         glUniform4f(uniformLoc, vec4D.x, vec4D.y, vec4D.z, vec4D.w); 
     }
 
+    //connects a uniform block to a binding point, false if the program has no such block
+    bool bindUniformBlock(const std::string &name, unsigned int binding)
+    {
+        std::map<std::string, bool>::iterator found = uniformBlocks.find(name);
+        if(found != uniformBlocks.end())
+            return found->second;
+
+        unsigned int index = glGetUniformBlockIndex(progID.get(), name.c_str());
+        bool exists = index != GL_INVALID_INDEX;
+        if(exists)
+            glUniformBlockBinding(progID.get(), index, binding);
+
+        uniformBlocks[name] = exists;
+        return exists;
+    }
+
     void setVec3(const std::string &name, glm::vec3 vec3D) const
     {
         int uniformLoc;
-        uniformLoc = glGetUniformLocation(progID, name.c_str()); 
+        uniformLoc = glGetUniformLocation(progID.get(), name.c_str()); 
         glUniform3f(uniformLoc, vec3D.x, vec3D.y, vec3D.z); 
     }
 };
 
+//starts many shaders at once and reports how far the batch is, so loading screens don't freeze
+class shaderBatch
+{
+    public:
+    std::vector<shader*> shaders;
+
+    void add(shader *batchShader, const char* vertexPath, const char* fragmentPath)
+    {
+        batchShader->loadShadersAsync(vertexPath, fragmentPath);
+        shaders.push_back(batchShader);
+    }
+
+    //number of shaders that finished (ready or failed), never blocks with KHR_parallel_shader_compile
+    int poll()
+    {
+        int done = 0;
+        for(shader *batchShader : shaders)
+        {
+            if(batchShader->isReady() || batchShader->hasFailed())
+                done++;
+        }
+        return done;
+    }
+
+    bool isDone()
+    {
+        return poll() == (int)shaders.size();
+    }
+};
+
 #endif
\ No newline at end of file
@@ -0,0 +1,426 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <memory>
+
+#include <glm/glm.hpp>
+
+#include "physics.h"
+
+/* delta of two snapshots. The snapshots are compared as 32 bit words and the xor of each word is stored
+as runs after the size of next: [size][unchanged words][changed words][the xor of the changed words]...
+Resting and sleeping bodies do not change, so most of a frame ends up in the unchanged runs. When the
+size changed the base is cut or padded with zeros to the new size, so the parts in front of the one that
+grew or shrank still line up */
+inline void encodeSnapshotDelta(const std::vector<unsigned char> &base, const std::vector<unsigned char> &next, std::vector<unsigned char> &delta)
+{
+    size_t words = next.size() / 4;
+    delta.resize(next.size() * 2 + 24);
+
+    const unsigned char *a = base.data();
+    const unsigned char *b = next.data();
+    unsigned char *out = delta.data();
+
+    static thread_local std::vector<unsigned char> padded;
+    if(base.size() != next.size())
+    {
+        padded.assign(next.size(), 0);
+        std::memcpy(padded.data(), base.data(), std::min(base.size(), next.size()));
+        a = padded.data();
+    }
+
+    uint64_t size = next.size();
+    std::memcpy(out, &size, 8);
+    out += 8;
+
+    auto difference = [&](size_t i){
+        uint32_t x, y;
+        std::memcpy(&x, a + i * 4, 4);
+        std::memcpy(&y, b + i * 4, 4);
+        return x ^ y;
+    };
+
+    size_t i = 0;
+    while(i < words)
+    {
+        //unchanged words are skipped 8 at a time first
+        size_t runStart = i;
+        while(i + 8 <= words && std::memcmp(a + i * 4, b + i * 4, 32) == 0)
+            i += 8;
+        while(i < words && difference(i) == 0)
+            i++;
+        uint32_t unchanged = i - runStart;
+
+        //a single unchanged word is cheaper to keep in the changed run than to start a new pair of runs
+        size_t start = i;
+        while(i < words && !(difference(i) == 0 && (i + 1 == words || difference(i + 1) == 0)))
+            i++;
+        uint32_t changed = i - start;
+
+        std::memcpy(out, &unchanged, 4);
+        std::memcpy(out + 4, &changed, 4);
+        out += 8;
+
+        for(size_t j = start; j < i; j++)
+        {
+            uint32_t x = difference(j);
+            std::memcpy(out, &x, 4);
+            out += 4;
+        }
+    }
+
+    //sizes that are not a multiple of 4 keep the last bytes as they are
+    for(size_t j = words * 4; j < next.size(); j++)
+        *out++ = next[j];
+
+    delta.resize(out - delta.data());
+}
+
+//turns the previous snapshot into the next one in place, resized the same way the encoder padded it
+inline void applySnapshotDelta(const std::vector<unsigned char> &delta, std::vector<unsigned char> &snapshot)
+{
+    uint64_t size;
+    std::memcpy(&size, delta.data(), 8);
+    snapshot.resize(size, 0);
+
+    size_t words = snapshot.size() / 4;
+    const unsigned char *in = delta.data() + 8;
+    const unsigned char *end = delta.data() + delta.size() - (snapshot.size() - words * 4);
+    unsigned char *out = snapshot.data();
+
+    size_t i = 0;
+    while(in < end && i < words)
+    {
+        uint32_t unchanged, changed;
+        std::memcpy(&unchanged, in, 4);
+        std::memcpy(&changed, in + 4, 4);
+        in += 8;
+        i += unchanged;
+
+        for(uint32_t j = 0; j < changed; j++, i++, in += 4)
+        {
+            uint32_t x, y;
+            std::memcpy(&x, out + i * 4, 4);
+            std::memcpy(&y, in, 4);
+            x ^= y;
+            std::memcpy(out + i * 4, &x, 4);
+        }
+    }
+
+    for(size_t j = words * 4; j < snapshot.size(); j++)
+        snapshot[j] = *end++;
+}
+
+/* the last frames of a physicsWorld for rollback and replay seeking. Every frame is stored as a delta
+against the frame before it, with a full keyframe every few frames so restoring never replays more than
+keyframeInterval deltas. Rolling back is
+
+    history.rollback(world, confirmedFrame);
+    for(long long frame = confirmedFrame + 1; frame <= currentFrame; frame++)
+    {
+        //apply the inputs of the frame
+        world.fixedStep(clock);
+        history.record(world, frame);
+    }
+*/
+class snapshotHistory{
+    private:
+    struct frameRecord{
+        long long frame = -1;
+        bool keyframe = false;
+        std::vector<unsigned char> data; // full snapshot or delta against the record before
+    };
+
+    std::vector<frameRecord> records; // ring in recording order
+    int first = 0;
+    int count = 0;
+    int keyframeInterval;
+    int sinceKeyframe = 0;
+
+    std::vector<unsigned char> latest; // the newest frame decoded, base of the next delta
+    std::vector<unsigned char> scratch;
+
+    frameRecord &at(int i)
+    {
+        return records[(first + i) % records.size()];
+    }
+
+    //position of the frame in the ring, -1 when it is not there
+    int find(long long frame)
+    {
+        for(int i = count - 1; i >= 0; i--)
+        {
+            if(at(i).frame == frame)
+                return i;
+        }
+        return -1;
+    }
+
+    public:
+    snapshotHistory(int capacity = 120, int keyframeInterval = 30)
+    {
+        records.resize(std::max(1, capacity));
+        this->keyframeInterval = std::max(1, keyframeInterval);
+    }
+
+    //stores the snapshot taken at the end of frame, frames have to be recorded in order
+    void record(const std::vector<unsigned char> &snapshot, long long frame)
+    {
+        bool keyframe = count == 0 || sinceKeyframe + 1 >= keyframeInterval;
+
+        if(count == (int)records.size())
+            first = (first + 1) % records.size();
+        else
+            count++;
+
+        frameRecord &entry = at(count - 1);
+        entry.frame = frame;
+        entry.keyframe = keyframe;
+
+        if(keyframe)
+        {
+            entry.data = snapshot;
+            sinceKeyframe = 0;
+        }
+        else
+        {
+            encodeSnapshotDelta(latest, snapshot, entry.data);
+            sinceKeyframe++;
+        }
+        latest = snapshot;
+    }
+
+    void record(physicsWorld &world, long long frame)
+    {
+        world.saveSnapshot(scratch);
+        record(scratch, frame);
+    }
+
+    //decodes the frame into snapshot, false when it fell out of the history
+    bool get(long long frame, std::vector<unsigned char> &snapshot)
+    {
+        int index = find(frame);
+        if(index < 0)
+            return false;
+
+        int key = index;
+        while(key >= 0 && !at(key).keyframe)
+            key--;
+
+        //the keyframe this frame was built on was already overwritten
+        if(key < 0)
+            return false;
+
+        snapshot = at(key).data;
+        for(int i = key + 1; i <= index; i++)
+            applySnapshotDelta(at(i).data, snapshot);
+        return true;
+    }
+
+    //loads the frame into the world and forgets the newer frames, they are recorded again while re-simulating
+    bool rollback(physicsWorld &world, long long frame)
+    {
+        if(!get(frame, scratch) || !world.loadSnapshot(scratch))
+            return false;
+
+        int index = find(frame);
+        count = index + 1;
+
+        sinceKeyframe = 0;
+        for(int i = index; i >= 0 && !at(i).keyframe; i--)
+            sinceKeyframe++;
+
+        latest = scratch;
+        return true;
+    }
+
+    void clear()
+    {
+        first = 0;
+        count = 0;
+        sinceKeyframe = 0;
+        latest.clear();
+    }
+
+    long long getOldestFrame()
+    {
+        return count > 0 ? at(0).frame : -1;
+    }
+
+    long long getNewestFrame()
+    {
+        return count > 0 ? at(count - 1).frame : -1;
+    }
+
+    //bytes held by the recorded frames
+    size_t getMemoryUsage()
+    {
+        size_t bytes = 0;
+        for(int i = 0; i < count; i++)
+            bytes += at(i).data.size();
+        return bytes;
+    }
+};
+
+struct snapshotBenchmarkResult{
+    //microseconds per 1000 bodies
+    double saveTime = 0.0; // copying the bodies into a snapshot
+    double recordTime = 0.0; // snapshot and delta against the previous frame
+    double restoreTime = 0.0; // decoding the frame with the longest delta chain and loading it
+    double bytesPerFrame = 0.0; // average size of a recorded frame
+    double rawBytesPerFrame = 0.0;
+    int resizedFrames = 0; // frames whose snapshot size differed from the frame before
+};
+
+/* cost of snapshots of a bodyStorage where movingFraction of the bodies fall and the others rest, which is
+what delta compression is good at. Frames are recorded with a keyframe every 30, the restore timed is the
+one right before a keyframe */
+inline snapshotBenchmarkResult benchmarkSnapshots(int bodyCount = 1000, int frames = 240, float movingFraction = 0.25f)
+{
+    bodyStorage bodies;
+    srand(1);
+    for(int i = 0; i < bodyCount; i++)
+    {
+        bodyState state;
+        state.position = glm::vec3(rand() % 1000 * 0.1f, rand() % 1000 * 0.1f, 0.0f);
+        state.acceleration = glm::vec3(0.0f, -98.0f, 0.0f);
+        state.flags = (rand() / (float)RAND_MAX < movingFraction) ? BODY_GRAVITY | BODY_COLLISION : BODY_COLLISION | BODY_SLEEPING;
+        bodies.create(state);
+    }
+
+    const int keyframeInterval = 30;
+    snapshotHistory history(frames, keyframeInterval);
+    std::vector<unsigned char> snapshot(bodyStorage::stateSize(bodyCount));
+
+    double saveSeconds = 0.0, recordSeconds = 0.0;
+    for(int frame = 0; frame < frames; frame++)
+    {
+        bodies.storePrevious();
+        bodies.integrate(1.0f / 60.0f);
+
+        auto start = std::chrono::steady_clock::now();
+        bodies.saveState(snapshot.data());
+        auto saved = std::chrono::steady_clock::now();
+        history.record(snapshot, frame);
+        auto recorded = std::chrono::steady_clock::now();
+
+        saveSeconds += std::chrono::duration<double>(saved - start).count();
+        recordSeconds += std::chrono::duration<double>(recorded - start).count();
+    }
+
+    //the last delta before the newest keyframe has the longest chain
+    long long deepest = (frames - 1) / keyframeInterval * keyframeInterval - 1;
+    if(deepest < 0)
+        deepest = frames - 1;
+
+    const int restores = 20;
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < restores; i++)
+    {
+        history.get(deepest, snapshot);
+        bodies.loadState(snapshot.data());
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double scale = 1e6 * 1000.0 / std::max(1, bodyCount);
+
+    snapshotBenchmarkResult result;
+    result.saveTime = saveSeconds / frames * scale;
+    result.recordTime = recordSeconds / frames * scale;
+    result.restoreTime = std::chrono::duration<double>(end - start).count() / restores * scale;
+    result.bytesPerFrame = (double)history.getMemoryUsage() / frames;
+    result.rawBytesPerFrame = (double)bodyStorage::stateSize(bodyCount);
+    return result;
+}
+
+/* the same through physicsWorld::saveSnapshot, so the warm start cache is in every frame and changes size
+as boxes land and bounce. objectCount boxes and circles fall onto a floor from different heights */
+inline snapshotBenchmarkResult benchmarkWorldSnapshots(int objectCount = 1000, int frames = 240)
+{
+    //declared before the world, its destructor gives the bodies back to the objects
+    std::vector<std::unique_ptr<gameObject>> objects;
+    gameObject floor;
+    physicsWorld world;
+
+    floor.block2D(objectCount * 2.0f, 2.0f);
+    floor.setCollisionStatus(true);
+    floor.setStatic(true);
+    floor.setPosition(glm::vec3(0.0f, -1.0f, 0.0f));
+    floor.updateTransform();
+    world.addObject(&floor);
+
+    srand(1);
+    for(int i = 0; i < objectCount; i++)
+    {
+        gameObject *object = new gameObject();
+        if(i % 3 == 0)
+            object->circle2D(1.0f);
+        else
+            object->block2D(2.0f, 2.0f);
+        object->setCollisionStatus(true);
+        object->setRestitution(0.2f);
+        object->setGravityStatus(true);
+        object->setAcceleration(GRAVITY);
+        object->setPosition(glm::vec3(rand() % (objectCount * 2) - objectCount, 2.0f + rand() % 100, 0.0f));
+        object->updateTransform();
+        world.addObject(object);
+        objects.emplace_back(object);
+    }
+
+    const int keyframeInterval = 30;
+    snapshotHistory history(frames, keyframeInterval);
+    std::vector<unsigned char> snapshot, previous;
+
+    double saveSeconds = 0.0, recordSeconds = 0.0;
+    size_t rawBytes = 0;
+    int resized = 0;
+    for(int frame = 0; frame < frames; frame++)
+    {
+        world.step(1.0f / 60.0f);
+
+        auto start = std::chrono::steady_clock::now();
+        world.saveSnapshot(snapshot);
+        auto saved = std::chrono::steady_clock::now();
+        history.record(snapshot, frame);
+        auto recorded = std::chrono::steady_clock::now();
+
+        saveSeconds += std::chrono::duration<double>(saved - start).count();
+        recordSeconds += std::chrono::duration<double>(recorded - start).count();
+        rawBytes += snapshot.size();
+        if(frame > 0 && snapshot.size() != previous.size())
+            resized++;
+        previous.swap(snapshot);
+    }
+
+    long long deepest = (frames - 1) / keyframeInterval * keyframeInterval - 1;
+    if(deepest < 0)
+        deepest = frames - 1;
+
+    const int restores = 20;
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < restores; i++)
+    {
+        history.get(deepest, snapshot);
+        world.loadSnapshot(snapshot);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double scale = 1e6 * 1000.0 / std::max(1, objectCount);
+
+    snapshotBenchmarkResult result;
+    result.saveTime = saveSeconds / frames * scale;
+    result.recordTime = recordSeconds / frames * scale;
+    result.restoreTime = std::chrono::duration<double>(end - start).count() / restores * scale;
+    result.bytesPerFrame = (double)history.getMemoryUsage() / frames;
+    result.rawBytesPerFrame = (double)rawBytes / frames;
+    result.resizedFrames = resized;
+    return result;
+}
+
+#endif
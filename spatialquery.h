@@ -0,0 +1,891 @@
+#ifndef SPATIALQUERY_H
+#define SPATIALQUERY_H
+
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+
+#include <glm/glm.hpp>
+
+#include "game.h"
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define SPATIALQUERY_SSE
+#endif
+
+//closest thing a ray or a sphere cast ran into
+struct rayHit{
+    gameObject *object = NULL;
+    float distance = 0.0f;
+    glm::vec3 point = glm::vec3(0.0f, 0.0f, 0.0f);
+    glm::vec3 normal = glm::vec3(0.0f, 0.0f, 0.0f);
+};
+
+struct rayBenchmarkResult{
+    double raysPerSecond = 0.0;
+    int rays = 0;
+    int hits = 0;
+};
+
+/* answers spatial questions about a set of gameObjects: ray casts, sphere casts, overlaps and closest points.
+Keeps a bounding volume hierarchy over the world bounds like the cullingSystem, refit by update() every step
+and rebuilt from scratch every few steps or after objects were added. Terrain objects (sheet3D/terrain meshes)
+are hit exactly by rays, all other queries use their bounds */
+class spatialQuery{
+    private:
+    static const int leafSize = 4;
+    static const int maxDepth = 64;
+
+    struct bvhNode{
+        boundingBox box;
+        int left = -1; // right child is always left + 1
+        int start = 0; // first item for leaves
+        int count = 0; // 0 for inner nodes
+    };
+
+    //height grid of a terrain object, rays are marched through its cells in the local space of the mesh
+    struct terrainGrid{
+        const std::vector<float> *vertices;
+        int parts;
+        glm::mat4 world;
+        glm::mat4 inverseWorld;
+    };
+
+    std::vector<gameObject*> objects;
+    std::vector<int> terrainOf; // index into terrains per object, -1 for normal objects
+    std::vector<terrainGrid> terrains;
+
+    std::vector<bvhNode> nodes;
+    std::vector<int> items; // object indices ordered so every leaf is a contiguous range
+    std::vector<boundingBox> boxes;
+    std::vector<collisionShape> shapes;
+
+    bool dirty = true;
+    int refitCount = 0;
+    int rebuildInterval = 30; // refits before the tree is rebuilt to undo the quality loss of moving objects
+
+    static boundingBox merge(const boundingBox &a, const boundingBox &b)
+    {
+        return {glm::min(a.min, b.min), glm::max(a.max, b.max)};
+    }
+
+    void build(int index, int start, int count)
+    {
+        boundingBox box = boxes[items[start]];
+        boundingBox centroidBox = {(box.min + box.max) * 0.5f, (box.min + box.max) * 0.5f};
+        for(int i = start + 1; i < start + count; i++)
+        {
+            const boundingBox &b = boxes[items[i]];
+            glm::vec3 centroid = (b.min + b.max) * 0.5f;
+            box = merge(box, b);
+            centroidBox = merge(centroidBox, {centroid, centroid});
+        }
+        nodes[index].box = box;
+
+        if(count <= leafSize)
+        {
+            nodes[index].start = start;
+            nodes[index].count = count;
+            return;
+        }
+
+        glm::vec3 size = centroidBox.max - centroidBox.min;
+        int axis = (size.x > size.y && size.x > size.z) ? 0 : (size.y > size.z ? 1 : 2);
+        int half = count / 2;
+
+        std::nth_element(items.begin() + start, items.begin() + start + half, items.begin() + start + count, [&](int a, int b){
+            return boxes[a].min[axis] + boxes[a].max[axis] < boxes[b].min[axis] + boxes[b].max[axis];
+        });
+
+        int left = nodes.size();
+        nodes.push_back(bvhNode());
+        nodes.push_back(bvhNode());
+        nodes[index].left = left;
+
+        build(left, start, half);
+        build(left + 1, start + half, count - half);
+    }
+
+    void refit()
+    {
+        for(int i = nodes.size() - 1; i >= 0; i--)
+        {
+            bvhNode &node = nodes[i];
+            if(node.count > 0)
+            {
+                node.box = boxes[items[node.start]];
+                for(int j = node.start + 1; j < node.start + node.count; j++)
+                    node.box = merge(node.box, boxes[items[j]]);
+            }
+            else
+            {
+                node.box = merge(nodes[node.left].box, nodes[node.left + 1].box);
+            }
+        }
+    }
+
+    void readObjects()
+    {
+        int size = objects.size();
+        boxes.resize(size);
+        shapes.resize(size);
+
+        for(int i = 0; i < size; i++)
+        {
+            shapes[i] = objects[i]->getCollisionShape();
+            shapes[i].hasCollision = true; // queries see everything, not only colliders
+            boxes[i] = shapes[i].box;
+
+            //circles are tested as spheres, which stick out of the flat bounds of a 2D circle
+            if(shapes[i].type == SHAPE_SPHERE)
+            {
+                glm::vec3 radius(shapes[i].sphere.radius);
+                boxes[i] = merge(boxes[i], {shapes[i].sphere.center - radius, shapes[i].sphere.center + radius});
+            }
+
+            if(terrainOf[i] >= 0)
+            {
+                terrainGrid &grid = terrains[terrainOf[i]];
+                grid.world = objects[i]->getWorldMatrix();
+                grid.inverseWorld = glm::inverse(grid.world);
+            }
+        }
+    }
+
+    //slab test that also works for flat boxes and rays lying in their plane
+    static bool rayBox(const boundingBox &box, const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, float &enter, int &axis)
+    {
+        float tMin = 0.0f, tMax = maxDistance;
+        axis = -1;
+
+        for(int k = 0; k < 3; k++)
+        {
+            if(direction[k] == 0.0f)
+            {
+                if(origin[k] < box.min[k] || origin[k] > box.max[k])
+                    return false;
+                continue;
+            }
+
+            float t0 = (box.min[k] - origin[k]) / direction[k];
+            float t1 = (box.max[k] - origin[k]) / direction[k];
+            if(t0 > t1) std::swap(t0, t1);
+
+            if(t0 > tMin)
+            {
+                tMin = t0;
+                axis = k;
+            }
+            tMax = std::min(tMax, t1);
+
+            if(tMin > tMax)
+                return false;
+        }
+
+        enter = tMin;
+        return true;
+    }
+
+    static bool rayTriangle(const glm::vec3 &origin, const glm::vec3 &direction, const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c, float &t)
+    {
+        glm::vec3 edge1 = b - a;
+        glm::vec3 edge2 = c - a;
+        glm::vec3 p = glm::cross(direction, edge2);
+        float determinant = glm::dot(edge1, p);
+        if(std::abs(determinant) < 1e-12f)
+            return false;
+
+        float inverse = 1.0f / determinant;
+        glm::vec3 s = origin - a;
+        float u = glm::dot(s, p) * inverse;
+        if(u < 0.0f || u > 1.0f)
+            return false;
+
+        glm::vec3 q = glm::cross(s, edge1);
+        float v = glm::dot(direction, q) * inverse;
+        if(v < 0.0f || u + v > 1.0f)
+            return false;
+
+        t = glm::dot(edge2, q) * inverse;
+        return t >= 0.0f;
+    }
+
+    //walks the cells under the ray in the local space of the grid and tests their two triangles
+    bool rayTerrain(const terrainGrid &grid, const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, float &distance, glm::vec3 &normal)
+    {
+        const std::vector<float> &v = *grid.vertices;
+        int parts = grid.parts;
+
+        //the same t works in both spaces since the direction is transformed without normalizing
+        glm::vec3 o = glm::vec3(grid.inverseWorld * glm::vec4(origin, 1.0f));
+        glm::vec3 d = glm::vec3(grid.inverseWorld * glm::vec4(direction, 0.0f));
+
+        float cellX = v[3] - v[0];
+        float cellY = v[3 * parts + 1] - v[1];
+        if(cellX <= 0.0f || cellY <= 0.0f)
+            return false;
+
+        //clip the ray to the rectangle of the grid
+        boundingBox area = {glm::vec3(v[0], v[1], -1e30f), glm::vec3(v[0] + cellX * (parts - 1), v[1] + cellY * (parts - 1), 1e30f)};
+        float t;
+        int axis;
+        if(!rayBox(area, o, d, maxDistance, t, axis))
+            return false;
+
+        auto vertex = [&](int row, int column){
+            int i = 3 * (row * parts + column);
+            return glm::vec3(v[i], v[i + 1], v[i + 2]);
+        };
+
+        glm::vec3 start = o + d * t;
+        int column = std::min(parts - 2, std::max(0, (int)((start.x - v[0]) / cellX)));
+        int row = std::min(parts - 2, std::max(0, (int)((start.y - v[1]) / cellY)));
+
+        int stepX = d.x > 0.0f ? 1 : -1;
+        int stepY = d.y > 0.0f ? 1 : -1;
+        float nextX = d.x != 0.0f ? (v[0] + (column + (stepX > 0)) * cellX - o.x) / d.x : 1e30f;
+        float nextY = d.y != 0.0f ? (v[1] + (row + (stepY > 0)) * cellY - o.y) / d.y : 1e30f;
+        float deltaX = d.x != 0.0f ? cellX / std::abs(d.x) : 1e30f;
+        float deltaY = d.y != 0.0f ? cellY / std::abs(d.y) : 1e30f;
+
+        for(int i = 0; i < 2 * parts; i++)
+        {
+            glm::vec3 a = vertex(row, column), b = vertex(row, column + 1), c = vertex(row + 1, column), e = vertex(row + 1, column + 1);
+
+            float best = 1e30f;
+            glm::vec3 localNormal;
+            float hitT;
+            if(rayTriangle(o, d, a, b, c, hitT) && hitT < best)
+            {
+                best = hitT;
+                localNormal = glm::cross(b - a, c - a);
+            }
+            if(rayTriangle(o, d, c, b, e, hitT) && hitT < best)
+            {
+                best = hitT;
+                localNormal = glm::cross(b - c, e - c);
+            }
+
+            if(best <= maxDistance)
+            {
+                distance = best;
+                normal = glm::normalize(glm::vec3(glm::transpose(grid.inverseWorld) * glm::vec4(localNormal, 0.0f)));
+                if(glm::dot(normal, direction) > 0.0f)
+                    normal = -normal;
+                return true;
+            }
+
+            //next cell along the ray
+            if(nextX < nextY)
+            {
+                if(nextX > maxDistance) return false;
+                column += stepX;
+                nextX += deltaX;
+            }
+            else
+            {
+                if(nextY > maxDistance) return false;
+                row += stepY;
+                nextY += deltaY;
+            }
+
+            if(column < 0 || row < 0 || column > parts - 2 || row > parts - 2)
+                return false;
+        }
+        return false;
+    }
+
+    //exact ray test against one item, distance is only written on a hit closer than maxDistance
+    bool rayItem(int object, const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, rayHit &hit)
+    {
+        float distance;
+        glm::vec3 normal(0.0f);
+
+        if(terrainOf[object] >= 0)
+        {
+            if(!rayTerrain(terrains[terrainOf[object]], origin, direction, maxDistance, distance, normal))
+                return false;
+        }
+        else if(shapes[object].type == SHAPE_SPHERE)
+        {
+            boundingSphere sphere = shapes[object].sphere;
+            glm::vec3 offset = origin - sphere.center;
+            float b = glm::dot(offset, direction);
+            float c = glm::dot(offset, offset) - sphere.radius * sphere.radius;
+            float discriminant = b * b - c;
+            if(discriminant < 0.0f)
+                return false;
+
+            distance = std::max(0.0f, -b - std::sqrt(discriminant));
+            if(distance > maxDistance || (c > 0.0f && b > 0.0f))
+                return false;
+            normal = c > 0.0f ? glm::normalize(origin + direction * distance - sphere.center) : -direction;
+        }
+        else
+        {
+            int axis;
+            if(!rayBox(shapes[object].box, origin, direction, maxDistance, distance, axis))
+                return false;
+
+            //starting inside reports a hit at the origin facing the ray
+            if(axis < 0)
+                normal = -direction;
+            else
+                normal[axis] = direction[axis] > 0.0f ? -1.0f : 1.0f;
+        }
+
+        hit.object = objects[object];
+        hit.distance = distance;
+        hit.point = origin + direction * distance;
+        hit.normal = normal;
+        return true;
+    }
+
+    void prepare()
+    {
+        if(dirty)
+            rebuild();
+    }
+
+    static float boxDistanceSquared(const boundingBox &box, const glm::vec3 &point)
+    {
+        glm::vec3 d = glm::max(glm::vec3(0.0f), glm::max(box.min - point, point - box.max));
+        return glm::dot(d, d);
+    }
+
+    public:
+    void addObject(gameObject *objPtr)
+    {
+        objects.push_back(objPtr);
+        terrainOf.push_back(-1);
+        dirty = true;
+    }
+
+    //a mesh made by sheet3D/terrain, rays hit its triangles instead of its bounds
+    void addTerrain(gameObject *objPtr)
+    {
+        const std::vector<float> &vertices = objPtr->getVertices();
+        int parts = objPtr->getGridSize();
+        if(parts < 2 || (int)vertices.size() < 3 * parts * parts)
+        {
+            addObject(objPtr);
+            return;
+        }
+
+        objects.push_back(objPtr);
+        terrainOf.push_back(terrains.size());
+        terrains.push_back({&vertices, parts, glm::mat4(1.0f), glm::mat4(1.0f)});
+        dirty = true;
+    }
+
+    void removeObject(gameObject *objPtr)
+    {
+        for(int i = objects.size() - 1; i >= 0; i--)
+        {
+            if(objects[i] != objPtr)
+                continue;
+
+            int terrain = terrainOf[i];
+            objects.erase(objects.begin() + i);
+            terrainOf.erase(terrainOf.begin() + i);
+
+            //the terrains after the removed one move down a slot
+            if(terrain >= 0)
+            {
+                terrains.erase(terrains.begin() + terrain);
+                for(int &index : terrainOf)
+                {
+                    if(index > terrain)
+                        index--;
+                }
+            }
+        }
+        dirty = true;
+    }
+
+    void clear()
+    {
+        objects.clear();
+        terrainOf.clear();
+        terrains.clear();
+        dirty = true;
+    }
+
+    void setRebuildInterval(int interval)
+    {
+        rebuildInterval = std::max(1, interval);
+    }
+
+    void rebuild()
+    {
+        int size = objects.size();
+
+        nodes.clear();
+        items.resize(size);
+        for(int i = 0; i < size; i++)
+            items[i] = i;
+
+        readObjects();
+
+        if(size > 0)
+        {
+            nodes.reserve(2 * size);
+            nodes.push_back(bvhNode());
+            build(0, 0, size);
+        }
+
+        dirty = false;
+        refitCount = 0;
+    }
+
+    //call once per step after the physics moved the objects
+    void update()
+    {
+        if(dirty || ++refitCount >= rebuildInterval)
+        {
+            rebuild();
+            return;
+        }
+
+        readObjects();
+        refit();
+    }
+
+    //closest hit along the ray, the direction does not have to be normalized. ignore is never hit
+    bool raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, rayHit &hit, gameObject *ignore = NULL)
+    {
+        prepare();
+        if(nodes.empty() || direction == glm::vec3(0.0f))
+            return false;
+
+        glm::vec3 dir = glm::normalize(direction);
+        bool found = false;
+        float best = maxDistance;
+
+        int stack[maxDepth];
+        int top = 0;
+        stack[top++] = 0;
+
+        while(top > 0)
+        {
+            const bvhNode &node = nodes[stack[--top]];
+
+            float enter;
+            int axis;
+            if(!rayBox(node.box, origin, dir, best, enter, axis))
+                continue;
+
+            if(node.count > 0)
+            {
+                for(int i = node.start; i < node.start + node.count; i++)
+                {
+                    if(objects[items[i]] == ignore)
+                        continue;
+
+                    if(rayItem(items[i], origin, dir, best, hit))
+                    {
+                        best = hit.distance;
+                        found = true;
+                    }
+                }
+                continue;
+            }
+
+            //the nearer child goes on top so it is visited first and shrinks best for the other one
+            float enterLeft, enterRight;
+            int axisLeft, axisRight;
+            bool hitLeft = rayBox(nodes[node.left].box, origin, dir, best, enterLeft, axisLeft);
+            bool hitRight = rayBox(nodes[node.left + 1].box, origin, dir, best, enterRight, axisRight);
+
+            if(hitLeft && hitRight)
+            {
+                bool leftFirst = enterLeft <= enterRight;
+                stack[top++] = leftFirst ? node.left + 1 : node.left;
+                stack[top++] = leftFirst ? node.left : node.left + 1;
+            }
+            else if(hitLeft)
+                stack[top++] = node.left;
+            else if(hitRight)
+                stack[top++] = node.left + 1;
+        }
+
+        return found;
+    }
+
+    //true if nothing blocks the segment, e.g. line of sight between two points
+    bool lineOfSight(const glm::vec3 &from, const glm::vec3 &to, gameObject *ignore = NULL)
+    {
+        glm::vec3 offset = to - from;
+        rayHit hit;
+
+        //the ignored object (usually the one looking) is skipped inside the traversal
+        return !raycast(from, offset, glm::length(offset), hit, ignore);
+    }
+
+    /* traces groups of 4 rays together: a node is visited once for the whole packet and tested with one SSE
+    slab test for all of its rays, which pays off when the rays are coherent (sight lines of one agent).
+    hits[i].object stays NULL for rays that hit nothing */
+    void raycastPacket(const glm::vec3 *origins, const glm::vec3 *directions, int count, float maxDistance, rayHit *hits)
+    {
+        prepare();
+
+        for(int first = 0; first < count; first += 4)
+        {
+            int size = std::min(4, count - first);
+            glm::vec3 dirs[4];
+            float best[4] = {maxDistance, maxDistance, maxDistance, maxDistance};
+
+            for(int i = 0; i < size; i++)
+            {
+                hits[first + i] = rayHit();
+                dirs[i] = directions[first + i] == glm::vec3(0.0f) ? glm::vec3(0.0f) : glm::normalize(directions[first + i]);
+                if(dirs[i] == glm::vec3(0.0f))
+                    best[i] = -1.0f;
+            }
+            for(int i = size; i < 4; i++)
+                best[i] = -1.0f; // unused lanes never pass the node test
+
+            if(nodes.empty())
+                continue;
+
+#ifdef SPATIALQUERY_SSE
+            //packet in structure of arrays layout, zero directions get a huge inverse instead of infinity
+            float ox[4], oy[4], oz[4], ix[4], iy[4], iz[4];
+            for(int i = 0; i < 4; i++)
+            {
+                glm::vec3 o = origins[first + std::min(i, size - 1)];
+                glm::vec3 d = dirs[std::min(i, size - 1)];
+                ox[i] = o.x; oy[i] = o.y; oz[i] = o.z;
+                ix[i] = d.x != 0.0f ? 1.0f / d.x : 1e30f;
+                iy[i] = d.y != 0.0f ? 1.0f / d.y : 1e30f;
+                iz[i] = d.z != 0.0f ? 1.0f / d.z : 1e30f;
+            }
+            __m128 originX = _mm_loadu_ps(ox), originY = _mm_loadu_ps(oy), originZ = _mm_loadu_ps(oz);
+            __m128 inverseX = _mm_loadu_ps(ix), inverseY = _mm_loadu_ps(iy), inverseZ = _mm_loadu_ps(iz);
+#endif
+
+            int stack[maxDepth];
+            int top = 0;
+            stack[top++] = 0;
+
+            while(top > 0)
+            {
+                const bvhNode &node = nodes[stack[--top]];
+                int mask = 0;
+
+#ifdef SPATIALQUERY_SSE
+                //node boxes are padded a little so rays lying in the plane of a flat box still enter it
+                __m128 t0x = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.box.min.x - 1e-4f), originX), inverseX);
+                __m128 t1x = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.box.max.x + 1e-4f), originX), inverseX);
+                __m128 t0y = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.box.min.y - 1e-4f), originY), inverseY);
+                __m128 t1y = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.box.max.y + 1e-4f), originY), inverseY);
+                __m128 t0z = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.box.min.z - 1e-4f), originZ), inverseZ);
+                __m128 t1z = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.box.max.z + 1e-4f), originZ), inverseZ);
+
+                __m128 enter = _mm_max_ps(_mm_max_ps(_mm_min_ps(t0x, t1x), _mm_min_ps(t0y, t1y)), _mm_max_ps(_mm_min_ps(t0z, t1z), _mm_setzero_ps()));
+                __m128 exit = _mm_min_ps(_mm_min_ps(_mm_max_ps(t0x, t1x), _mm_max_ps(t0y, t1y)), _mm_min_ps(_mm_max_ps(t0z, t1z), _mm_loadu_ps(best)));
+                mask = _mm_movemask_ps(_mm_cmple_ps(enter, exit));
+#else
+                for(int i = 0; i < 4; i++)
+                {
+                    float enter;
+                    int axis;
+                    if(best[i] >= 0.0f && rayBox(node.box, origins[first + std::min(i, size - 1)], dirs[i], best[i], enter, axis))
+                        mask |= 1 << i;
+                }
+#endif
+                if(!mask)
+                    continue;
+
+                if(node.count > 0)
+                {
+                    for(int r = 0; r < size; r++)
+                    {
+                        if(!(mask & (1 << r)))
+                            continue;
+
+                        for(int i = node.start; i < node.start + node.count; i++)
+                        {
+                            if(rayItem(items[i], origins[first + r], dirs[r], best[r], hits[first + r]))
+                                best[r] = hits[first + r].distance;
+                        }
+                    }
+                    continue;
+                }
+
+                stack[top++] = node.left + 1;
+                stack[top++] = node.left;
+            }
+        }
+    }
+
+    //closest hit of a sphere moved along the direction, an object the sphere starts in is hit at distance 0
+    bool sphereCast(const glm::vec3 &origin, const glm::vec3 &direction, float radius, float maxDistance, rayHit &hit)
+    {
+        prepare();
+        if(nodes.empty() || direction == glm::vec3(0.0f))
+            return false;
+
+        glm::vec3 dir = glm::normalize(direction);
+        collisionShape sphere;
+        sphere.type = SHAPE_SPHERE;
+        sphere.hasCollision = true;
+        sphere.sphere = {origin, radius};
+
+        bool found = false;
+        float best = maxDistance;
+
+        int stack[maxDepth];
+        int top = 0;
+        stack[top++] = 0;
+
+        while(top > 0)
+        {
+            const bvhNode &node = nodes[stack[--top]];
+
+            //the sphere touches the node when its center ray hits the box grown by the radius
+            boundingBox grown = {node.box.min - glm::vec3(radius), node.box.max + glm::vec3(radius)};
+            float enter;
+            int axis;
+            if(!rayBox(grown, origin, dir, best, enter, axis))
+                continue;
+
+            if(node.count == 0)
+            {
+                stack[top++] = node.left + 1;
+                stack[top++] = node.left;
+                continue;
+            }
+
+            for(int i = node.start; i < node.start + node.count; i++)
+            {
+                int object = items[i];
+                float toi;
+                glm::vec3 normal;
+
+                collided overlap = testShapes(sphere, shapes[object]);
+                if(overlap.hasCollided)
+                {
+                    toi = 0.0f;
+                    normal = -overlap.normal;
+                }
+                else if(!sweepShapes(sphere, dir * best, shapes[object], toi, normal))
+                    continue;
+                else
+                    normal = -normal;
+
+                float distance = toi * best;
+                hit.object = objects[object];
+                hit.distance = distance;
+                hit.point = origin + dir * distance;
+                hit.normal = normal;
+                best = distance;
+                found = true;
+            }
+        }
+
+        return found;
+    }
+
+    //every object whose bounds (or circle) overlap the box
+    void overlapBox(const boundingBox &box, std::vector<gameObject*> &results)
+    {
+        prepare();
+        results.clear();
+        if(nodes.empty())
+            return;
+
+        int stack[maxDepth];
+        int top = 0;
+        stack[top++] = 0;
+
+        while(top > 0)
+        {
+            const bvhNode &node = nodes[stack[--top]];
+            if(node.box.min.x > box.max.x || node.box.max.x < box.min.x ||
+               node.box.min.y > box.max.y || node.box.max.y < box.min.y ||
+               node.box.min.z > box.max.z || node.box.max.z < box.min.z)
+                continue;
+
+            if(node.count == 0)
+            {
+                stack[top++] = node.left + 1;
+                stack[top++] = node.left;
+                continue;
+            }
+
+            for(int i = node.start; i < node.start + node.count; i++)
+            {
+                const collisionShape &shape = shapes[items[i]];
+                bool overlaps = shape.type == SHAPE_SPHERE ? boxDistanceSquared(box, shape.sphere.center) <= shape.sphere.radius * shape.sphere.radius
+                                               : !(shape.box.min.x > box.max.x || shape.box.max.x < box.min.x ||
+                                                   shape.box.min.y > box.max.y || shape.box.max.y < box.min.y ||
+                                                   shape.box.min.z > box.max.z || shape.box.max.z < box.min.z);
+                if(overlaps)
+                    results.push_back(objects[items[i]]);
+            }
+        }
+    }
+
+    //every object whose bounds (or circle) overlap the sphere
+    void overlapSphere(const glm::vec3 &center, float radius, std::vector<gameObject*> &results)
+    {
+        prepare();
+        results.clear();
+        if(nodes.empty())
+            return;
+
+        int stack[maxDepth];
+        int top = 0;
+        stack[top++] = 0;
+
+        while(top > 0)
+        {
+            const bvhNode &node = nodes[stack[--top]];
+            if(boxDistanceSquared(node.box, center) > radius * radius)
+                continue;
+
+            if(node.count == 0)
+            {
+                stack[top++] = node.left + 1;
+                stack[top++] = node.left;
+                continue;
+            }
+
+            for(int i = node.start; i < node.start + node.count; i++)
+            {
+                const collisionShape &shape = shapes[items[i]];
+                bool overlaps = shape.type == SHAPE_SPHERE ? glm::length(shape.sphere.center - center) <= shape.sphere.radius + radius
+                                               : boxDistanceSquared(shape.box, center) <= radius * radius;
+                if(overlaps)
+                    results.push_back(objects[items[i]]);
+            }
+        }
+    }
+
+    //nearest object to the point within maxDistance and the closest point on its bounds (or circle)
+    gameObject *closestPoint(const glm::vec3 &point, float maxDistance, glm::vec3 &closest)
+    {
+        prepare();
+        if(nodes.empty())
+            return NULL;
+
+        gameObject *nearest = NULL;
+        float best = maxDistance * maxDistance;
+
+        int stack[maxDepth];
+        int top = 0;
+        stack[top++] = 0;
+
+        while(top > 0)
+        {
+            const bvhNode &node = nodes[stack[--top]];
+            if(boxDistanceSquared(node.box, point) > best)
+                continue;
+
+            if(node.count == 0)
+            {
+                //nearer child on top
+                bool leftFirst = boxDistanceSquared(nodes[node.left].box, point) <= boxDistanceSquared(nodes[node.left + 1].box, point);
+                stack[top++] = leftFirst ? node.left + 1 : node.left;
+                stack[top++] = leftFirst ? node.left : node.left + 1;
+                continue;
+            }
+
+            for(int i = node.start; i < node.start + node.count; i++)
+            {
+                const collisionShape &shape = shapes[items[i]];
+                glm::vec3 candidate;
+
+                if(shape.type == SHAPE_SPHERE)
+                {
+                    glm::vec3 offset = point - shape.sphere.center;
+                    float length = glm::length(offset);
+                    candidate = length > shape.sphere.radius ? shape.sphere.center + offset * (shape.sphere.radius / length) : point;
+                }
+                else
+                    candidate = glm::clamp(point, shape.box.min, shape.box.max);
+
+                float distanceSquared = glm::dot(candidate - point, candidate - point);
+                if(distanceSquared <= best)
+                {
+                    best = distanceSquared;
+                    closest = candidate;
+                    nearest = objects[items[i]];
+                }
+            }
+        }
+
+        return nearest;
+    }
+
+    //batched raycasts, packets of 4 when usePackets is set, otherwise one traversal per ray
+    void raycast(const std::vector<glm::vec3> &origins, const std::vector<glm::vec3> &directions, float maxDistance, std::vector<rayHit> &hits, bool usePackets = true)
+    {
+        int count = std::min(origins.size(), directions.size());
+        hits.resize(count);
+
+        if(usePackets)
+        {
+            raycastPacket(origins.data(), directions.data(), count, maxDistance, hits.data());
+            return;
+        }
+
+        for(int i = 0; i < count; i++)
+        {
+            hits[i] = rayHit();
+            if(!raycast(origins[i], directions[i], maxDistance, hits[i]))
+                hits[i] = rayHit();
+        }
+    }
+
+    /* rays per second against the current objects. Rays come in groups of 4 from one point with slightly
+    different directions, like the sight lines of one agent, and start inside the bounds of the scene */
+    rayBenchmarkResult benchmarkRaycasts(int rayCount = 1 << 16, bool usePackets = true)
+    {
+        prepare();
+        rayBenchmarkResult result;
+        if(nodes.empty())
+            return result;
+
+        boundingBox scene = nodes[0].box;
+        std::vector<glm::vec3> origins(rayCount), directions(rayCount);
+        std::vector<rayHit> hits;
+
+        srand(1);
+        for(int i = 0; i < rayCount; i += 4)
+        {
+            glm::vec3 origin = scene.min + (scene.max - scene.min) * glm::vec3(rand() / (float)RAND_MAX, rand() / (float)RAND_MAX, rand() / (float)RAND_MAX);
+            glm::vec3 direction(rand() / (float)RAND_MAX - 0.5f, rand() / (float)RAND_MAX - 0.5f, (scene.max.z > scene.min.z) ? rand() / (float)RAND_MAX - 0.5f : 0.0f);
+
+            for(int j = i; j < std::min(rayCount, i + 4); j++)
+            {
+                origins[j] = origin;
+                directions[j] = direction + glm::vec3(0.02f * (j - i), -0.02f * (j - i), 0.0f);
+            }
+        }
+
+        float maxDistance = glm::length(scene.max - scene.min);
+
+        auto start = std::chrono::steady_clock::now();
+        raycast(origins, directions, maxDistance, hits, usePackets);
+        auto end = std::chrono::steady_clock::now();
+
+        double seconds = std::chrono::duration<double>(end - start).count();
+        result.rays = rayCount;
+        for(const rayHit &hit : hits)
+            result.hits += hit.object != NULL;
+        result.raysPerSecond = seconds > 0.0 ? rayCount / seconds : 0.0;
+        return result;
+    }
+
+    int getObjectCount()
+    {
+        return objects.size();
+    }
+};
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef TIMESTEP_H
+#define TIMESTEP_H
+
+#include <algorithm>
+#include <cmath>
+
+/* fixed step simulation clock. The frame time goes into an accumulator and the simulation runs whole
+steps out of it, so the physics behave the same at any frame rate. The leftover time is the
+interpolation factor used to draw the bodies between the last two steps. physicsWorld::update() runs
+the whole thing, objects outside a world are stepped the same way:
+
+    int steps = clock.advance(frameTime);
+    for(int i = 0; i < steps; i++)
+    {
+        defaultBodies.storePrevious();
+        for(int j = 0; j < clock.getSubsteps(); j++)
+            player.updatePhysics(clock.getSubstepTime());
+    }
+    defaultBodies.setInterpolation(clock.getAlpha());
+*/
+class fixedTimestep{
+    private:
+    float stepTime; // length of one full step
+    int substeps; // every step is split into this many integration substeps
+    int maxSteps; // catch up limit per frame, the rest of the time is dropped
+    float accumulator = 0.0f;
+
+    public:
+    fixedTimestep(float stepRate = 60.0f, int substeps = 1, int maxSteps = 5)
+    {
+        setStepRate(stepRate);
+        this->substeps = std::max(1, substeps);
+        this->maxSteps = std::max(1, maxSteps);
+    }
+
+    //steps per second
+    void setStepRate(float stepRate)
+    {
+        stepTime = 1.0f / stepRate;
+    }
+
+    void setSubsteps(int substeps)
+    {
+        this->substeps = std::max(1, substeps);
+    }
+
+    void setMaxSteps(int maxSteps)
+    {
+        this->maxSteps = std::max(1, maxSteps);
+    }
+
+    //adds the frame time and returns how many steps to run this frame
+    int advance(float frameTime)
+    {
+        accumulator += std::max(0.0f, frameTime);
+
+        int steps = (int)(accumulator / stepTime);
+        if(steps > maxSteps)
+        {
+            //a long hitch would otherwise make every following frame slower, drop the backlog instead
+            steps = maxSteps;
+            accumulator = std::fmod(accumulator, stepTime);
+        }
+        else
+            accumulator -= steps * stepTime;
+
+        return steps;
+    }
+
+    float getStepTime()
+    {
+        return stepTime;
+    }
+
+    float getSubstepTime()
+    {
+        return stepTime / substeps;
+    }
+
+    int getSubsteps()
+    {
+        return substeps;
+    }
+
+    //how far the frame is into the next step, 0 to 1
+    float getAlpha()
+    {
+        return std::min(1.0f, accumulator / stepTime);
+    }
+
+    void reset()
+    {
+        accumulator = 0.0f;
+    }
+};
+
+#endif